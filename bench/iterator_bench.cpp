@@ -0,0 +1,95 @@
+#include "../iterator/iterator.h"
+
+#include <benchmark/benchmark.h>
+
+//ForwardIterator遍历：虚接口逐个取、nextRef()、nextBatch()、无堆分配的迭代器以及指针区间，元素个数由Arg给出
+namespace{
+
+CustomCollection<int> makeCollection(int count){
+    CustomCollection<int> collection;
+    collection.reserve(count);
+    for(int i = 0; i < count; i++){
+        collection.add(i);
+    }
+    return collection;
+}
+
+void setItems(benchmark::State &state){
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+void BM_ForwardIteratorNext(benchmark::State &state){
+    CustomCollection<int> collection = makeCollection(static_cast<int>(state.range(0)));
+    for(auto _ : state){
+        auto iterator = collection.createIterator();
+        long long sum = 0;
+        while(iterator->hasNext()){
+            sum += iterator->next();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    setItems(state);
+}
+
+void BM_ForwardIteratorNextRef(benchmark::State &state){
+    CustomCollection<int> collection = makeCollection(static_cast<int>(state.range(0)));
+    for(auto _ : state){
+        CustomCollection<int>::ForwardIterator iterator(collection);
+        long long sum = 0;
+        while(iterator.hasNext()){
+            sum += iterator.nextRef();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    setItems(state);
+}
+
+void BM_ForwardIteratorNextBatch(benchmark::State &state){
+    CustomCollection<int> collection = makeCollection(static_cast<int>(state.range(0)));
+    int buffer[256];
+    for(auto _ : state){
+        auto iterator = collection.createIterator();
+        long long sum = 0;
+        int count;
+        while((count = iterator->nextBatch(buffer, 256)) > 0){
+            for(int i = 0; i < count; i++){
+                sum += buffer[i];
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    setItems(state);
+}
+
+void BM_InlineIterator(benchmark::State &state){
+    CustomCollection<int> collection = makeCollection(static_cast<int>(state.range(0)));
+    for(auto _ : state){
+        auto iterator = collection.createInlineIterator();
+        long long sum = 0;
+        while(iterator->hasNext()){
+            sum += iterator->next();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    setItems(state);
+}
+
+void BM_RangeFor(benchmark::State &state){
+    CustomCollection<int> collection = makeCollection(static_cast<int>(state.range(0)));
+    for(auto _ : state){
+        long long sum = 0;
+        for(int item : collection){
+            sum += item;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    setItems(state);
+}
+
+}
+
+BENCHMARK(BM_ForwardIteratorNext)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_ForwardIteratorNextRef)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_ForwardIteratorNextBatch)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_InlineIterator)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_RangeFor)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
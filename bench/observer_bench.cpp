@@ -0,0 +1,127 @@
+#include "../observer/observer.h"
+
+#include <benchmark/benchmark.h>
+
+//ConcreteSubject::notify()在1、1k、100k个观察者下的扇出开销，以及注销/重新注册的开销
+namespace{
+
+class CountingObserver : public Observer{
+    private:
+        std::uint64_t count = 0;
+
+    public:
+        void update(Subject*) override{
+            count++;
+        }
+
+        std::uint64_t getCount() const{
+            return count;
+        }
+};
+
+void BM_ConcreteSubjectNotify(benchmark::State &state){
+    std::vector<CountingObserver> observers(static_cast<std::size_t>(state.range(0)));
+    ConcreteSubject subject;
+    for(auto &observer : observers){
+        subject.attach(&observer);
+    }
+    int value = 0;
+    for(auto _ : state){
+        subject.setState(++value);//状态每次都变化，不会被变化抑制跳过
+        subject.notify();
+    }
+    benchmark::DoNotOptimize(observers.front().getCount());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+void BM_ConcreteSubjectNotifyWeak(benchmark::State &state){
+    std::vector<std::shared_ptr<CountingObserver>> observers;
+    ConcreteSubject subject;
+    for(int64_t i = 0; i < state.range(0); i++){
+        observers.push_back(std::make_shared<CountingObserver>());
+        subject.attach(std::weak_ptr<Observer>(observers.back()));
+    }
+    int value = 0;
+    for(auto _ : state){
+        subject.setState(++value);
+        subject.notify();
+    }
+    benchmark::DoNotOptimize(observers.front()->getCount());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+void BM_ConcurrentSubjectNotify(benchmark::State &state){
+    std::vector<CountingObserver> observers(static_cast<std::size_t>(state.range(0)));
+    ConcurrentSubject subject;
+    for(auto &observer : observers){
+        subject.attach(&observer);
+    }
+    for(auto _ : state){
+        subject.notify();
+    }
+    benchmark::DoNotOptimize(observers.front().getCount());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+//已有range(0)个观察者时，按句柄注销一个再重新注册
+void BM_DetachChurnBySubscription(benchmark::State &state){
+    std::vector<CountingObserver> observers(static_cast<std::size_t>(state.range(0)));
+    std::vector<Subscription> subscriptions;
+    ConcreteSubject subject;
+    for(auto &observer : observers){
+        subscriptions.push_back(subject.attach(&observer));
+    }
+    std::size_t next = 0;
+    for(auto _ : state){
+        subject.detach(subscriptions[next]);
+        subscriptions[next] = subject.attach(&observers[next]);
+        next = (next + 1) % observers.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+//同上，但按指针注销，需要线性扫描
+void BM_DetachChurnByPointer(benchmark::State &state){
+    std::vector<CountingObserver> observers(static_cast<std::size_t>(state.range(0)));
+    ConcreteSubject subject;
+    for(auto &observer : observers){
+        subject.attach(&observer);
+    }
+    std::size_t next = 0;
+    for(auto _ : state){
+        subject.detach(&observers[next]);
+        subject.attach(&observers[next]);
+        next = (next + 1) % observers.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+//EventBus上按句柄注销后重新订阅；Arg是分片中已有的订阅个数，分散在100个主题上
+void BM_BusSubscribeChurn(benchmark::State &state){
+    std::vector<CountingObserver> observers(static_cast<std::size_t>(state.range(0)));
+    EventBus bus(1);
+    std::vector<std::unique_ptr<BusSubject>> subjects;
+    for(int i = 0; i < 100; i++){
+        subjects.push_back(std::make_unique<BusSubject>(bus));
+    }
+    std::vector<Subscription> subscriptions;
+    for(std::size_t i = 0; i < observers.size(); i++){
+        subscriptions.push_back(subjects[i % subjects.size()]->attach(&observers[i]));
+    }
+    std::size_t next = 0;
+    for(auto _ : state){
+        bus.unsubscribe(subscriptions[next]);
+        subscriptions[next] = subjects[next % subjects.size()]->attach(&observers[next]);
+        next = (next + 1) % observers.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+}
+
+BENCHMARK(BM_ConcreteSubjectNotify)->Arg(1)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_ConcreteSubjectNotifyWeak)->Arg(1)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_ConcurrentSubjectNotify)->Arg(1)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_DetachChurnBySubscription)->Arg(1)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_DetachChurnByPointer)->Arg(1)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_BusSubscribeChurn)->Arg(1)->Arg(1000)->Arg(100000);
@@ -0,0 +1,211 @@
+#include "../visitor/visitor.h"
+
+#include <filesystem>
+#include <map>
+#include <benchmark/benchmark.h>
+
+// Zoo::accept()在不同种群规模下的开销，以及几种分派/存储方式的对比；Arg是动物数量，Lion和Tiger各一半
+// 另外对比三种构造方式构造再销毁整个Zoo的开销、其中名字驻留的开销，以及映射二进制镜像后直接遍历的开销
+namespace {
+
+// 同一规模的Zoo只构造一次，供多个基准复用
+Zoo& population(std::size_t count, bool heap) {
+    static std::map<std::pair<std::size_t, bool>, std::unique_ptr<Zoo>> zoos;
+    auto& zoo = zoos[{count, heap}];
+    if (!zoo) {
+        zoo = std::make_unique<Zoo>();
+        zoo->reserve(count / 2 + 1, count / 2 + 1);
+        for (std::size_t i = 0; i < count; i++) {
+            std::string name = (i % 2 == 0 ? "Lion" : "Tiger") + std::to_string(i);
+            if (heap) {
+                if (i % 2 == 0) {
+                    zoo->addAnimal(std::make_unique<Lion>(zoo->names(), name));
+                } else {
+                    zoo->addAnimal(std::make_unique<Tiger>(zoo->names(), name));
+                }
+            } else if (i % 2 == 0) {
+                zoo->emplaceAnimal<Lion>(name);
+            } else {
+                zoo->emplaceAnimal<Tiger>(name);
+            }
+        }
+    }
+    return *zoo;
+}
+
+// 构造基准使用的名字，只生成一次
+const std::vector<std::string>& lionNames(std::size_t count) {
+    static std::map<std::size_t, std::vector<std::string>> cache;
+    auto& names = cache[count];
+    if (names.empty()) {
+        for (std::size_t i = 0; i < count; i++) {
+            names.push_back("Lion" + std::to_string(i));
+        }
+    }
+    return names;
+}
+
+// 每个规模写出一个镜像文件，进程退出时删除
+class ZooImages {
+private:
+    std::map<std::size_t, std::string> paths;
+
+public:
+    ~ZooImages() {
+        for (const auto& entry : paths) {
+            std::error_code error;
+            std::filesystem::remove(entry.second, error);
+        }
+    }
+
+    const std::string& path(std::size_t count) {
+        auto& path = paths[count];
+        if (path.empty()) {
+            path = (std::filesystem::temp_directory_path() / ("zoo-bench-" + std::to_string(count) + ".img")).string();
+            ZooImageWriter::write(population(count, false), path);
+        }
+        return path;
+    }
+};
+
+void setItems(benchmark::State& state) {
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+void BM_ZooAccept(benchmark::State& state) {
+    Zoo& zoo = population(static_cast<std::size_t>(state.range(0)), false);
+    for (auto _ : state) {
+        NameLengthVisitor visitor;
+        zoo.accept(static_cast<AnimalVisitor&>(visitor));
+        benchmark::DoNotOptimize(visitor.getTotal());
+    }
+    setItems(state);
+}
+
+void BM_ZooAcceptHeap(benchmark::State& state) {
+    Zoo& zoo = population(static_cast<std::size_t>(state.range(0)), true);
+    for (auto _ : state) {
+        NameLengthVisitor visitor;
+        zoo.accept(static_cast<AnimalVisitor&>(visitor));
+        benchmark::DoNotOptimize(visitor.getTotal());
+    }
+    setItems(state);
+}
+
+void BM_ZooAcceptStatic(benchmark::State& state) {
+    Zoo& zoo = population(static_cast<std::size_t>(state.range(0)), false);
+    for (auto _ : state) {
+        NameLengthVisitor visitor;
+        zoo.acceptStatic(visitor);
+        benchmark::DoNotOptimize(visitor.getTotal());
+    }
+    setItems(state);
+}
+
+void BM_ZooParallelAccept(benchmark::State& state) {
+    Zoo& zoo = population(static_cast<std::size_t>(state.range(0)), false);
+    for (auto _ : state) {
+        NameLengthVisitor visitor;
+        zoo.parallelAccept(visitor);
+        benchmark::DoNotOptimize(visitor.getTotal());
+    }
+    setItems(state);
+}
+
+void BM_ZooBuildMakeUnique(benchmark::State& state) {
+    const auto& names = lionNames(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        Zoo zoo;
+        for (const std::string& name : names) {
+            zoo.addAnimal(std::make_unique<Lion>(zoo.names(), name));
+        }
+        benchmark::DoNotOptimize(zoo.size());
+    }
+    setItems(state);
+}
+
+void BM_ZooBuildMakeAnimal(benchmark::State& state) {
+    const auto& names = lionNames(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        Zoo zoo;
+        for (const std::string& name : names) {
+            zoo.makeAnimal<Lion>(name);
+        }
+        benchmark::DoNotOptimize(zoo.size());
+    }
+    setItems(state);
+}
+
+void BM_ZooBuildEmplace(benchmark::State& state) {
+    const auto& names = lionNames(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        Zoo zoo;
+        zoo.reserve(names.size(), 0, names.size());
+        for (const std::string& name : names) {
+            zoo.emplaceAnimal<Lion>(name);
+        }
+        benchmark::DoNotOptimize(zoo.size());
+    }
+    setItems(state);
+}
+
+// 单独测量名字驻留：每个名字都不同，每轮一个新的名字表，字符串分配在单调arena中
+void BM_NameTableIntern(benchmark::State& state) {
+    const auto& names = lionNames(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::pmr::monotonic_buffer_resource arena;
+        NameTable table(&arena);
+        for (const std::string& name : names) {
+            benchmark::DoNotOptimize(table.intern(name));
+        }
+    }
+    setItems(state);
+}
+
+// 每轮都重新打开映射，包含映射和校验文件头的开销；文件在页缓存中
+void BM_MappedZooAccept(benchmark::State& state) {
+    static ZooImages images;
+    const std::string& path = images.path(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        MappedZoo mappedZoo(path);
+        NameLengthVisitor visitor;
+        mappedZoo.accept(visitor);
+        benchmark::DoNotOptimize(visitor.getTotal());
+    }
+    setItems(state);
+}
+
+// 直接访问记录，不构造视图对象
+void BM_MappedZooAcceptRecords(benchmark::State& state) {
+    class NameLengthRecordVisitor final : public MappedAnimalVisitor {
+    public:
+        std::size_t total = 0;
+
+        void visit(const AnimalRecord&, std::string_view name) override {
+            total += name.size();
+        }
+    };
+
+    static ZooImages images;
+    const std::string& path = images.path(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        MappedZoo mappedZoo(path);
+        NameLengthRecordVisitor visitor;
+        mappedZoo.accept(visitor);
+        benchmark::DoNotOptimize(visitor.total);
+    }
+    setItems(state);
+}
+
+}
+
+BENCHMARK(BM_ZooAccept)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_ZooAcceptHeap)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_ZooAcceptStatic)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_ZooParallelAccept)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_ZooBuildMakeUnique)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_ZooBuildMakeAnimal)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_ZooBuildEmplace)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_NameTableIntern)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_MappedZooAccept)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_MappedZooAcceptRecords)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
@@ -0,0 +1,159 @@
+#ifndef COMMON_LOG_H
+#define COMMON_LOG_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+//编译期选择的轻量日志
+//级别低于LOG_LEVEL的日志语句在编译期被丢弃，参数也不会求值；开启的日志写入异步缓冲区，
+//由后台线程批量输出到std::cout，调用线程既不做同步I/O也不会每行flush
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF 5
+
+//默认：调试构建输出DEBUG及以上（包括构造/析构日志），发布构建（定义NDEBUG）只输出INFO及以上
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+namespace logging{
+
+//异步缓冲输出：write()只把一行追加到内存缓冲区，后台线程在缓冲区足够大或定时到期时整块写出
+//缓冲区为空时后台线程一直阻塞在条件变量上，不定时唤醒；进程空闲时没有任何开销
+class AsyncSink{
+    private:
+        static constexpr std::size_t FlushThreshold = 64 * 1024;
+        static constexpr std::chrono::milliseconds FlushInterval{50};
+
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::condition_variable written;
+        std::string pending;//等待写出的日志
+        std::string writing;//后台线程正在写出的日志，和pending交换以复用内存
+        std::uint64_t pushedBytes;
+        std::uint64_t writtenBytes;
+        std::uint64_t flushTarget;//flush()请求写出到的位置，writtenBytes达到之前持续有效
+        bool stopping;
+        std::thread worker;
+
+        void run(){
+            std::unique_lock<std::mutex> lock(mutex);
+            for(;;){
+                wakeup.wait(lock, [this]{ return stopping || !pending.empty(); });
+                //收到第一行后再攒一段时间，除非缓冲区已满、有人flush()或正在退出
+                wakeup.wait_for(lock, FlushInterval, [this]{
+                    return stopping || writtenBytes < flushTarget || pending.size() >= FlushThreshold;
+                });
+                if(!pending.empty()){
+                    writing.swap(pending);
+                    lock.unlock();
+                    std::cout.write(writing.data(), writing.size());
+                    std::cout.flush();
+                    lock.lock();
+                    writtenBytes += writing.size();
+                    writing.clear();
+                }
+                written.notify_all();
+                if(stopping && pending.empty()){
+                    return;
+                }
+            }
+        }
+
+        AsyncSink() : pushedBytes(0), writtenBytes(0), flushTarget(0), stopping(false){
+            worker = std::thread([this]{ run(); });
+        }
+
+    public:
+        //析构时写出剩余的全部日志
+        ~AsyncSink(){
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeup.notify_one();
+            worker.join();
+        }
+
+        AsyncSink(const AsyncSink&) = delete;
+        AsyncSink& operator=(const AsyncSink&) = delete;
+
+        //只在一批的第一行和缓冲区写满时唤醒后台线程
+        void write(std::string_view line){
+            bool wake;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                wake = pending.empty();
+                pending.append(line.data(), line.size());
+                pending.push_back('\n');
+                pushedBytes += line.size() + 1;
+                wake = wake || pending.size() >= FlushThreshold;
+            }
+            if(wake){
+                wakeup.notify_one();
+            }
+        }
+
+        //阻塞直到此前写入的日志全部输出；后台线程写出期间到来的flush()不会被上一轮的完成覆盖
+        void flush(){
+            std::unique_lock<std::mutex> lock(mutex);
+            std::uint64_t target = pushedBytes;
+            if(writtenBytes >= target){
+                return;
+            }
+            if(flushTarget < target){
+                flushTarget = target;
+            }
+            wakeup.notify_one();
+            written.wait(lock, [this, target]{ return writtenBytes >= target; });
+        }
+
+        static AsyncSink& instance(){
+            static AsyncSink sink;
+            return sink;
+        }
+};
+
+//把参数依次格式化成一行；每个线程复用自己的ostringstream
+template<typename... Args>
+void write(const Args&... args){
+    thread_local std::ostringstream stream;
+    stream.str(std::string());
+    (stream << ... << args);
+    AsyncSink::instance().write(stream.str());
+}
+
+inline void flush(){
+    AsyncSink::instance().flush();
+}
+
+}
+
+#define LOG_AT(level, ...) \
+    do{ \
+        if constexpr((level) >= LOG_LEVEL){ \
+            ::logging::write(__VA_ARGS__); \
+        } \
+    }while(0)
+
+#define LOG_TRACE(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif
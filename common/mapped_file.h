@@ -0,0 +1,111 @@
+#ifndef COMMON_MAPPED_FILE_H
+#define COMMON_MAPPED_FILE_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//只读的内存映射文件：打开时只建立映射，页面在第一次访问时才由操作系统读入
+//打开失败时抛出std::runtime_error；空文件映射为data() == nullptr、size() == 0
+class MappedFile{
+    private:
+        const char *address;
+        std::size_t length;
+
+        [[noreturn]] static void fail(const std::string &path, const std::string &what){
+            throw std::runtime_error("cannot map " + path + ": " + what);
+        }
+
+    public:
+        explicit MappedFile(const std::string &path) : address(nullptr), length(0){
+#ifdef _WIN32
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if(file == INVALID_HANDLE_VALUE){
+                fail(path, "CreateFile error " + std::to_string(GetLastError()));
+            }
+            LARGE_INTEGER fileSize;
+            if(!GetFileSizeEx(file, &fileSize)){
+                DWORD error = GetLastError();
+                CloseHandle(file);
+                fail(path, "GetFileSizeEx error " + std::to_string(error));
+            }
+            length = static_cast<std::size_t>(fileSize.QuadPart);
+            if(length > 0){
+                HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if(mapping == nullptr){
+                    DWORD error = GetLastError();
+                    CloseHandle(file);
+                    fail(path, "CreateFileMapping error " + std::to_string(error));
+                }
+                address = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                DWORD error = GetLastError();
+                CloseHandle(mapping);//视图会保持映射对象存活
+                if(address == nullptr){
+                    CloseHandle(file);
+                    fail(path, "MapViewOfFile error " + std::to_string(error));
+                }
+            }
+            CloseHandle(file);
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0){
+                fail(path, std::strerror(errno));
+            }
+            struct stat status;
+            if(::fstat(fd, &status) != 0){
+                int error = errno;
+                ::close(fd);
+                fail(path, std::strerror(error));
+            }
+            length = static_cast<std::size_t>(status.st_size);
+            if(length > 0){
+                void *mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(mapped == MAP_FAILED){
+                    int error = errno;
+                    ::close(fd);
+                    fail(path, std::strerror(error));
+                }
+                address = static_cast<const char*>(mapped);
+            }
+            ::close(fd);//映射建立后不再需要文件描述符
+#endif
+        }
+
+        ~MappedFile(){
+            if(address == nullptr){
+                return;
+            }
+#ifdef _WIN32
+            UnmapViewOfFile(address);
+#else
+            ::munmap(const_cast<char*>(address), length);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const{
+            return address;
+        }
+
+        std::size_t size() const{
+            return length;
+        }
+};
+
+#endif
@@ -0,0 +1,374 @@
+#ifndef COMMON_METRICS_H
+#define COMMON_METRICS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "log.h"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+//可选的运行时统计：计数器、延迟直方图和导出接口
+//埋点一律写成METRICS_ONLY(...)，METRICS_ENABLED为0（默认）时整段语句和成员在预处理阶段就被删除，
+//对象布局、通知路径都和没有埋点时完全一样
+#ifndef METRICS_ENABLED
+#define METRICS_ENABLED 0
+#endif
+
+#if METRICS_ENABLED
+#define METRICS_ONLY(...) __VA_ARGS__
+#else
+#define METRICS_ONLY(...)
+#endif
+
+namespace metrics{
+
+inline std::uint64_t nowNanos(){
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//最高位1的位置，value不能为0；GCC/Clang下编译为一条bsr/clz指令
+inline int highestBit(std::uint64_t value){
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    int index = 0;
+    while(value >>= 1){
+        index++;
+    }
+    return index;
+#endif
+}
+
+//给每个线程分配一个固定编号，用来选择直方图的分片
+inline std::size_t threadIndex(){
+    static std::atomic<std::size_t> next{0};
+    thread_local std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+//直方图的只读快照
+struct HistogramSnapshot{
+    std::vector<std::uint64_t> counts;//每个桶的计数
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+
+    double mean() const{
+        return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+    }
+
+    //第q（0到1之间）分位数所在桶的上界，相对误差不超过桶宽
+    std::uint64_t percentile(double q) const;
+};
+
+//HDR风格的对数-线性直方图，单位纳秒：每个2的幂区间再均分为SubBuckets个桶，相对误差不超过1/SubBuckets
+//记录时只对当前线程所属分片做一次relaxed的fetch_add，不加锁；分片在第一次使用时才分配
+class LatencyHistogram{
+    public:
+        static constexpr int SubBucketBits = 3;
+        static constexpr std::uint64_t SubBuckets = 1u << SubBucketBits;
+        static constexpr int MaxExponent = 40;//超过2^40纳秒（约18分钟）的值记在最后一个桶
+        static constexpr std::size_t BucketCount = (MaxExponent - SubBucketBits + 1) * SubBuckets;
+        static constexpr std::size_t ShardCount = 8;
+
+    private:
+        struct alignas(64) Shard{
+            std::atomic<std::uint64_t> counts[BucketCount];
+            std::atomic<std::uint64_t> sum;
+            std::atomic<std::uint64_t> max;
+
+            Shard() : sum(0), max(0){
+                for(auto &count : counts){
+                    count.store(0, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        std::atomic<Shard*> shards[ShardCount];
+
+        Shard& shard(){
+            std::atomic<Shard*> &slot = shards[threadIndex() % ShardCount];
+            Shard *current = slot.load(std::memory_order_acquire);
+            if(current == nullptr){
+                Shard *created = new Shard();
+                if(slot.compare_exchange_strong(current, created, std::memory_order_acq_rel)){
+                    current = created;
+                }else{
+                    delete created;//其他线程已经分配
+                }
+            }
+            return *current;
+        }
+
+    public:
+        LatencyHistogram(){
+            for(auto &slot : shards){
+                slot.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        ~LatencyHistogram(){
+            for(auto &slot : shards){
+                delete slot.load(std::memory_order_relaxed);
+            }
+        }
+
+        LatencyHistogram(const LatencyHistogram&) = delete;
+        LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+        //小于2*SubBuckets的值每个值一个桶，之后每个2的幂区间SubBuckets个桶
+        static std::size_t bucketOf(std::uint64_t value){
+            value = std::min<std::uint64_t>(value, (std::uint64_t(1) << MaxExponent) - 1);
+            if(value < 2 * SubBuckets){
+                return static_cast<std::size_t>(value);
+            }
+            int exponent = highestBit(value);
+            int shift = exponent - SubBucketBits;
+            return static_cast<std::size_t>((shift + 1) * SubBuckets + ((value >> shift) - SubBuckets));
+        }
+
+        //桶内最大的值
+        static std::uint64_t upperBound(std::size_t bucket){
+            if(bucket < 2 * SubBuckets){
+                return bucket;
+            }
+            int shift = static_cast<int>(bucket / SubBuckets) - 1;
+            std::uint64_t sub = bucket % SubBuckets + SubBuckets;
+            return ((sub + 1) << shift) - 1;
+        }
+
+        void record(std::uint64_t nanos){
+            Shard &target = shard();
+            target.counts[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+            target.sum.fetch_add(nanos, std::memory_order_relaxed);
+            std::uint64_t previous = target.max.load(std::memory_order_relaxed);
+            while(nanos > previous && !target.max.compare_exchange_weak(previous, nanos, std::memory_order_relaxed)){
+            }
+        }
+
+        void recordSince(std::uint64_t startNanos){
+            record(nowNanos() - startNanos);
+        }
+
+        //合并所有分片；与record()并发时得到的是某个近似时刻的结果
+        HistogramSnapshot snapshot() const{
+            HistogramSnapshot result;
+            result.counts.assign(BucketCount, 0);
+            for(const auto &slot : shards){
+                const Shard *current = slot.load(std::memory_order_acquire);
+                if(current == nullptr){
+                    continue;
+                }
+                for(std::size_t i = 0; i < BucketCount; i++){
+                    std::uint64_t count = current->counts[i].load(std::memory_order_relaxed);
+                    result.counts[i] += count;
+                    result.count += count;
+                }
+                result.sum += current->sum.load(std::memory_order_relaxed);
+                result.max = std::max(result.max, current->max.load(std::memory_order_relaxed));
+            }
+            return result;
+        }
+};
+
+inline std::uint64_t HistogramSnapshot::percentile(double q) const{
+    if(count == 0){
+        return 0;
+    }
+    std::uint64_t rank = static_cast<std::uint64_t>(std::clamp(q, 0.0, 1.0) * (count - 1)) + 1;
+    std::uint64_t seen = 0;
+    for(std::size_t i = 0; i < counts.size(); i++){
+        seen += counts[i];
+        if(seen >= rank){
+            return std::min(LatencyHistogram::upperBound(i), max);
+        }
+    }
+    return max;
+}
+
+//主题级计数器的快照
+struct CounterSnapshot{
+    std::uint64_t notifies = 0;//实际发出的notify()
+    std::uint64_t deliveries = 0;//调用update()的次数
+    std::uint64_t dropped = 0;//因背压被丢弃的状态
+    std::uint64_t coalesced = 0;//被合并（或因没有变化被抑制）的通知
+};
+
+//导出接口：exportSubject()对每个主题调用一次，随后对它的每个观察者调用一次exportObserver()
+class Exporter{
+    private:
+
+    protected:
+
+    public:
+        virtual ~Exporter() = default;
+        virtual void exportSubject(std::string_view subject, const CounterSnapshot &counters) = 0;
+        virtual void exportObserver(std::string_view subject, const void* observer, const HistogramSnapshot &latency) = 0;
+};
+
+//通过日志宏输出的导出器
+class LogExporter : public Exporter{
+    private:
+
+    protected:
+
+    public:
+        void exportSubject(std::string_view subject, const CounterSnapshot &counters) override{
+            LOG_INFO(subject, ": notifies=", counters.notifies, " deliveries=", counters.deliveries,
+                " dropped=", counters.dropped, " coalesced=", counters.coalesced);
+        }
+
+        void exportObserver(std::string_view subject, const void* observer, const HistogramSnapshot &latency) override{
+            LOG_INFO(subject, " observer ", observer, ": count=", latency.count,
+                " p50=", latency.percentile(0.5), "ns p99=", latency.percentile(0.99), "ns max=", latency.max, "ns");
+        }
+};
+
+class SubjectMetrics;
+
+//所有存活的SubjectMetrics，供exportAll()统一导出
+class Registry{
+    private:
+        std::mutex mutex;
+        std::vector<const SubjectMetrics*> subjects;
+
+    public:
+        void add(const SubjectMetrics* subject){
+            std::lock_guard<std::mutex> lock(mutex);
+            subjects.push_back(subject);
+        }
+
+        void remove(const SubjectMetrics* subject){
+            std::lock_guard<std::mutex> lock(mutex);
+            subjects.erase(std::remove(subjects.begin(), subjects.end(), subject), subjects.end());
+        }
+
+        //按注册顺序导出；持有锁期间不能创建或销毁主题
+        void exportAll(Exporter &exporter);
+
+        static Registry& instance(){
+            static Registry registry;
+            return registry;
+        }
+};
+
+//一个主题的计数器和每个观察者的延迟直方图
+//计数器用relaxed原子变量，可以在通知线程和投递线程中同时累加
+class SubjectMetrics{
+    private:
+        std::string name;
+        std::atomic<std::uint64_t> notifies;
+        std::atomic<std::uint64_t> deliveries;
+        std::atomic<std::uint64_t> dropped;
+        std::atomic<std::uint64_t> coalesced;
+        //每个订阅一个直方图，由订阅持有shared_ptr，这里只保存弱引用（按注册顺序）：
+        //订阅被注销、最后一份快照也释放后直方图随之释放，地址被复用的新观察者不会混入旧观察者的数据
+        struct Tracked{
+            const void* observer;
+            std::weak_ptr<const LatencyHistogram> histogram;
+        };
+
+        mutable std::mutex mutex;
+        std::vector<Tracked> tracked;
+        std::size_t pruneAt = 16;//tracked达到这个长度时清除已经释放的直方图
+
+        //均摊O(1)：每次清除后把阈值设为存活个数的两倍
+        void prune(){
+            tracked.erase(std::remove_if(tracked.begin(), tracked.end(), [](const Tracked &entry){
+                return entry.histogram.expired();
+            }), tracked.end());
+            pruneAt = std::max<std::size_t>(16, tracked.size() * 2);
+        }
+
+    public:
+        explicit SubjectMetrics(std::string name) : name(std::move(name)), notifies(0), deliveries(0), dropped(0), coalesced(0){
+            Registry::instance().add(this);
+        }
+
+        ~SubjectMetrics(){
+            Registry::instance().remove(this);
+        }
+
+        SubjectMetrics(const SubjectMetrics&) = delete;
+        SubjectMetrics& operator=(const SubjectMetrics&) = delete;
+
+        void countNotify(){
+            notifies.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void countDeliveries(std::uint64_t count = 1){
+            deliveries.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        void countDropped(){
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void countCoalesced(){
+            coalesced.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        //在attach()时调用一次，把返回的直方图存进订阅，之后每次投递直接记录，不需要再查表
+        std::shared_ptr<LatencyHistogram> track(const void* observer){
+            auto histogram = std::make_shared<LatencyHistogram>();
+            std::lock_guard<std::mutex> lock(mutex);
+            if(tracked.size() >= pruneAt){
+                prune();
+            }
+            tracked.push_back(Tracked{observer, histogram});
+            return histogram;
+        }
+
+        //仍被订阅持有的直方图个数
+        std::size_t trackedCount() const{
+            std::lock_guard<std::mutex> lock(mutex);
+            return static_cast<std::size_t>(std::count_if(tracked.begin(), tracked.end(), [](const Tracked &entry){
+                return !entry.histogram.expired();
+            }));
+        }
+
+        CounterSnapshot counters() const{
+            CounterSnapshot result;
+            result.notifies = notifies.load(std::memory_order_relaxed);
+            result.deliveries = deliveries.load(std::memory_order_relaxed);
+            result.dropped = dropped.load(std::memory_order_relaxed);
+            result.coalesced = coalesced.load(std::memory_order_relaxed);
+            return result;
+        }
+
+        void exportTo(Exporter &exporter) const{
+            exporter.exportSubject(name, counters());
+            std::lock_guard<std::mutex> lock(mutex);
+            for(const Tracked &entry : tracked){
+                if(auto histogram = entry.histogram.lock()){
+                    exporter.exportObserver(name, entry.observer, histogram->snapshot());
+                }
+            }
+        }
+};
+
+inline void Registry::exportAll(Exporter &exporter){
+    std::lock_guard<std::mutex> lock(mutex);
+    for(const SubjectMetrics* subject : subjects){
+        subject->exportTo(exporter);
+    }
+}
+
+}
+
+#endif
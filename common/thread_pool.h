@@ -0,0 +1,149 @@
+#ifndef COMMON_THREAD_POOL_H
+#define COMMON_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "log.h"
+
+//固定大小的线程池：任务放入共享队列，由工作线程依次取出执行
+class ThreadPool{
+    private:
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping;
+
+        void run(){
+            for(;;){
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [this]{ return stopping || !tasks.empty(); });
+                    if(stopping && tasks.empty()){
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop();
+                }
+                task();
+            }
+        }
+
+    protected:
+
+    public:
+        explicit ThreadPool(std::size_t threadCount = std::thread::hardware_concurrency()) : stopping(false){
+            threadCount = std::max<std::size_t>(threadCount, 1);
+            workers.reserve(threadCount);
+            for(std::size_t i = 0; i < threadCount; i++){
+                workers.emplace_back([this]{ run(); });
+            }
+        }
+
+        //析构时先执行完队列中剩余的任务，再回收线程
+        ~ThreadPool(){
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            condition.notify_all();
+            for(auto& worker : workers){
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        std::size_t size() const{
+            return workers.size();
+        }
+
+        //提交任务，通过返回的future获取结果或异常
+        template<typename Func>
+        std::future<std::invoke_result_t<Func>> submit(Func&& func){
+            using Result = std::invoke_result_t<Func>;
+            //std::function要求可拷贝，所以packaged_task放在shared_ptr里
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+            std::future<Result> result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks.emplace([task]{ (*task)(); });
+            }
+            condition.notify_one();
+            return result;
+        }
+
+        //把编号[0, count)的任务分给线程池中的线程和调用方线程，各线程循环领取下一个编号并调用func(index, slot)
+        //slot是领取线程的编号，取值[0, size()]，同一时刻只有一个线程使用某个slot，可以用来存放每个线程的局部状态
+        //所有任务完成后才返回，然后重新抛出第一个异常；调用方线程也在领取，即使在线程池任务中嵌套调用也不会死锁
+        template<typename Func>
+        void forEachChunk(std::size_t count, Func&& func){
+            if(count == 0){
+                return;
+            }
+            struct State{
+                std::atomic<std::size_t> nextIndex{0};
+                std::size_t finished = 0;
+                std::exception_ptr error;
+                std::mutex mutex;
+                std::condition_variable done;
+            };
+            auto state = std::make_shared<State>();
+
+            //领取结束后才开始执行的任务直接退出，不会访问已经返回的调用方的func
+            auto work = [state, count, &func](std::size_t slot){
+                for(;;){
+                    std::size_t index = state->nextIndex.fetch_add(1);
+                    if(index >= count){
+                        return;
+                    }
+                    try{
+                        func(index, slot);
+                    }catch(...){
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        if(!state->error){
+                            state->error = std::current_exception();
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if(++state->finished == count){
+                        state->done.notify_all();
+                    }
+                }
+            };
+
+            std::size_t helpers = std::min(size(), count - 1);
+            for(std::size_t i = 0; i < helpers; i++){
+                submit([work, i]{ work(i); });
+            }
+            work(helpers);
+
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->done.wait(lock, [&state, count]{ return state->finished == count; });
+            if(state->error){
+                std::rethrow_exception(state->error);
+            }
+        }
+
+        //进程内共享的线程池，线程数等于硬件并发数
+        //先构造日志的AsyncSink，它就晚于线程池析构，析构时执行的剩余任务仍然可以写日志
+        static ThreadPool& shared(){
+            logging::AsyncSink::instance();
+            static ThreadPool pool;
+            return pool;
+        }
+};
+
+#endif
@@ -1,105 +1,112 @@
-#include <iostream>
-#include <vector>
-#include <memory>
-
-template<typename T>
-class Iterator{
-    public:
-        virtual ~Iterator() = default;
-        virtual bool hasNext() = 0;
-        virtual T next() = 0;//返回迭代器当前元素并迭代到下一个
-};
-
-template<typename T>
-class Aggregate{
-    public:
-        virtual ~Aggregate() = default;
-        virtual std::unique_ptr<Iterator<T>> createIterator() = 0;
-        virtual int size() const = 0;
-        virtual T get(int index) const = 0;
-};
-
-template<typename T>
-class CustomCollection : public Aggregate<T>{
-    private:
-        std::vector<T> items;
-
-    protected:
-
-    public:
-
-        CustomCollection(){
-            std::cout << "CustomCollection created" << std::endl;
-        }
-
-        ~CustomCollection(){
-            std::cout << "CustomCollection destroyed" << std::endl;
-        }
-
-        void add(const T &item){
-            items.push_back(item);
-        }
-
-        int size() const override{
-            return items.size();
-        }
-
-        T get(int index) const override{
-            if(index >= 0 && index < items.size()){
-                return items[index];
-            }
-            throw std::out_of_range("Index out of range");
-        }
-
-        class ForwardIterator : public Iterator<T>{//内部类
-            private:
-                const CustomCollection<T> &collection;
-                int currentIndex;
-        
-            protected:
-        
-            public:
-                //列表初始化
-                ForwardIterator(const CustomCollection<T> &coll) : collection(coll), currentIndex(0){}
-        
-                bool hasNext() override{
-                    return currentIndex < collection.size();
-                }
-        
-                T next() override{
-                    if(!hasNext()){
-                        throw std::out_of_range("No more elements");
-                    }
-                    return collection.get(currentIndex++);
-                }
-        };
-
-        std::unique_ptr<Iterator<T>> createIterator() override{
-            return std::make_unique<ForwardIterator>(*this);
-        }
-};
+#include <sstream>
+#include "iterator.h"
 
 int main(){
     CustomCollection<int> collection;
+    collection.reserve(5);
     collection.add(1);
     collection.add(2);
-    collection.add(3);
-    collection.add(4);
-    collection.add(5);
+    int rest[] = {3, 4, 5};
+    collection.addAll(rest, rest + 3);
 
-    std::cout << "Factory Pattern Example:" << std::endl;
+    LOG_INFO("Factory Pattern Example:");
+    std::ostringstream line;
     auto iterator = collection.createIterator();
     while(iterator->hasNext()){
-        std::cout << iterator->next() << " ";
+        line << iterator->next() << " ";
     }
-    std::cout << std::endl;
+    LOG_INFO(line.str());
 
-    std::cout << "Outer class use inner class:" << std::endl;
+    LOG_INFO("Outer class use inner class:");
+    line.str("");
     CustomCollection<int>::ForwardIterator forwardIterator(collection);
     while(forwardIterator.hasNext()){
-        std::cout << forwardIterator.next() << " ";
+        line << forwardIterator.next() << " ";
+    }
+    LOG_INFO(line.str());
+
+    LOG_INFO("Inline iterator example:");
+    line.str("");
+    auto inlineIterator = collection.createInlineIterator();
+    while(inlineIterator->hasNext()){
+        line << inlineIterator->next() << " ";
+    }
+    LOG_INFO(line.str());
+
+    LOG_INFO("Batch example:");
+    line.str("");
+    auto batchIterator = collection.createIterator();
+    int buffer[2];
+    int count;
+    while((count = batchIterator->nextBatch(buffer, 2)) > 0){
+        for(int i = 0; i < count; i++){
+            line << buffer[i] << " ";
+        }
+        line << "| ";
+    }
+    LOG_INFO(line.str());
+
+    LOG_INFO("Range-for example:");
+    line.str("");
+    for(const int &item : collection){
+        line << item << " ";
+    }
+    LOG_INFO(line.str());
+
+    LOG_INFO("Lazy pipeline example:");
+    line.str("");
+    lazy(collection)
+        .filter([](const int &item){ return item % 2 == 1; })
+        .map([](const int &item){ return item * 10; })
+        .take(2)
+        .forEach([&line](int item){ line << item << " "; });
+    line << "| ";
+    lazy(collection).zip(lazy(collection).skip(1)).forEach([&line](std::pair<const int&, const int&> item){
+        line << item.first << "-" << item.second << " ";
+    });
+    line << "| ";
+    lazy(collection).chunk<2>().forEach([&line](const Chunk<int, 2> &chunk){
+        line << "[";
+        for(int item : chunk){
+            line << " " << item;
+        }
+        line << " ] ";
+    });
+    LOG_INFO(line.str());
+
+    LOG_INFO("Parallel example:");
+    std::atomic<int> sum(0);
+    collection.parallelForEach([&sum](const int &item){
+        sum += item;
+    });
+    LOG_INFO("sum = ", sum.load());
+
+    LOG_INFO("Reduction example:");
+    LOG_INFO("sum = ", collection.sum(),
+             ", min = ", collection.min(),
+             ", max = ", collection.max(),
+             ", odd = ", collection.countIf([](int item){ return item % 2 == 1; }),
+             ", dot = ", collection.dot(collection));
+
+    LOG_INFO("SoA example:");
+    {
+        SoACollection<int, double> records;//id, score
+        records.add(1, 0.5);
+        records.add(2, 1.5);
+        records.add(3, 2.5);
+        double total = 0;
+        for(double score : records.column<1>()){//只读score这一列
+            total += score;
+        }
+        LOG_INFO("score total = ", total);
+        line.str("");
+        auto rows = records.createInlineIterator();
+        while(rows->hasNext()){
+            auto row = rows->next();
+            line << std::get<0>(row) << ":" << std::get<1>(row) << " ";
+        }
+        LOG_INFO(line.str());
     }
-    std::cout << std::endl;
 
     return 0;
 }
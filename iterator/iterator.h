@@ -0,0 +1,1227 @@
+#ifndef ITERATOR_ITERATOR_H
+#define ITERATOR_ITERATOR_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <utility>
+#include <new>
+#include <cstddef>
+#include <optional>
+#include <array>
+#include <type_traits>
+#include <tuple>
+#include <stdexcept>
+#include "../common/log.h"
+#include "../common/thread_pool.h"
+
+//ITERATOR_CHECKED为1时nextRef()和惰性流水线的各阶段也做越界检查并抛出异常；默认只在调试构建（未定义NDEBUG）中开启
+#ifndef ITERATOR_CHECKED
+#ifdef NDEBUG
+#define ITERATOR_CHECKED 0
+#else
+#define ITERATOR_CHECKED 1
+#endif
+#endif
+
+//算术类型的归约内核：直接在连续数组上计算sum/min/max/dot
+//x86上运行时检测AVX2并选择向量化版本，AArch64上使用NEON，其余情况使用标量回退
+//标量版本用四个独立累加器打破依赖链，编译器可以用基线SSE2/NEON继续向量化
+//注意：向量化改变了浮点加法的结合顺序，结果可能与逐个相加有舍入误差；含NaN时min/max的结果未定义
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define REDUCTION_HAVE_AVX2 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define REDUCTION_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace reduction{
+
+template<typename T>
+T sumScalar(const T *data, std::size_t count){
+    T acc0 = T(), acc1 = T(), acc2 = T(), acc3 = T();
+    std::size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        acc0 += data[i];
+        acc1 += data[i + 1];
+        acc2 += data[i + 2];
+        acc3 += data[i + 3];
+    }
+    for(; i < count; i++){
+        acc0 += data[i];
+    }
+    return (acc0 + acc1) + (acc2 + acc3);
+}
+
+template<typename T>
+T dotScalar(const T *left, const T *right, std::size_t count){
+    T acc0 = T(), acc1 = T(), acc2 = T(), acc3 = T();
+    std::size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        acc0 += left[i] * right[i];
+        acc1 += left[i + 1] * right[i + 1];
+        acc2 += left[i + 2] * right[i + 2];
+        acc3 += left[i + 3] * right[i + 3];
+    }
+    for(; i < count; i++){
+        acc0 += left[i] * right[i];
+    }
+    return (acc0 + acc1) + (acc2 + acc3);
+}
+
+//count必须大于0
+template<typename T>
+T minScalar(const T *data, std::size_t count){
+    T result = data[0];
+    for(std::size_t i = 1; i < count; i++){
+        result = data[i] < result ? data[i] : result;
+    }
+    return result;
+}
+
+//count必须大于0
+template<typename T>
+T maxScalar(const T *data, std::size_t count){
+    T result = data[0];
+    for(std::size_t i = 1; i < count; i++){
+        result = result < data[i] ? data[i] : result;
+    }
+    return result;
+}
+
+#if REDUCTION_HAVE_AVX2
+//只检测一次CPU特性，之后每次调用只是一次可预测的分支
+inline bool hasAvx2(){
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+__attribute__((target("avx2"))) inline int sumAvx2(const int *data, std::size_t count){
+    __m256i acc = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        acc = _mm256_add_epi32(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+    }
+    alignas(32) int lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    return sumScalar(lanes, 8) + sumScalar(data + i, count - i);
+}
+
+__attribute__((target("avx2"))) inline int dotAvx2(const int *left, const int *right, std::size_t count){
+    __m256i acc = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + i));
+        acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(a, b));
+    }
+    alignas(32) int lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    return sumScalar(lanes, 8) + dotScalar(left + i, right + i, count - i);
+}
+
+__attribute__((target("avx2"))) inline int minAvx2(const int *data, std::size_t count){
+    if(count < 8){
+        return minScalar(data, count);
+    }
+    __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    std::size_t i = 8;
+    for(; i + 8 <= count; i += 8){
+        acc = _mm256_min_epi32(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+    }
+    alignas(32) int lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    int result = minScalar(lanes, 8);
+    return i < count ? std::min(result, minScalar(data + i, count - i)) : result;
+}
+
+__attribute__((target("avx2"))) inline int maxAvx2(const int *data, std::size_t count){
+    if(count < 8){
+        return maxScalar(data, count);
+    }
+    __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    std::size_t i = 8;
+    for(; i + 8 <= count; i += 8){
+        acc = _mm256_max_epi32(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+    }
+    alignas(32) int lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    int result = maxScalar(lanes, 8);
+    return i < count ? std::max(result, maxScalar(data + i, count - i)) : result;
+}
+
+__attribute__((target("avx2"))) inline double sumAvx2(const double *data, std::size_t count){
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(data + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(data + i + 4));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, _mm256_add_pd(acc0, acc1));
+    return sumScalar(lanes, 4) + sumScalar(data + i, count - i);
+}
+
+__attribute__((target("avx2"))) inline double dotAvx2(const double *left, const double *right, std::size_t count){
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(left + i), _mm256_loadu_pd(right + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(left + i + 4), _mm256_loadu_pd(right + i + 4)));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, _mm256_add_pd(acc0, acc1));
+    return sumScalar(lanes, 4) + dotScalar(left + i, right + i, count - i);
+}
+
+__attribute__((target("avx2"))) inline double minAvx2(const double *data, std::size_t count){
+    if(count < 4){
+        return minScalar(data, count);
+    }
+    __m256d acc = _mm256_loadu_pd(data);
+    std::size_t i = 4;
+    for(; i + 4 <= count; i += 4){
+        acc = _mm256_min_pd(acc, _mm256_loadu_pd(data + i));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, acc);
+    double result = minScalar(lanes, 4);
+    return i < count ? std::min(result, minScalar(data + i, count - i)) : result;
+}
+
+__attribute__((target("avx2"))) inline double maxAvx2(const double *data, std::size_t count){
+    if(count < 4){
+        return maxScalar(data, count);
+    }
+    __m256d acc = _mm256_loadu_pd(data);
+    std::size_t i = 4;
+    for(; i + 4 <= count; i += 4){
+        acc = _mm256_max_pd(acc, _mm256_loadu_pd(data + i));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, acc);
+    double result = maxScalar(lanes, 4);
+    return i < count ? std::max(result, maxScalar(data + i, count - i)) : result;
+}
+#endif
+
+#if REDUCTION_HAVE_NEON
+inline int sumNeon(const int *data, std::size_t count){
+    int32x4_t acc = vdupq_n_s32(0);
+    std::size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        acc = vaddq_s32(acc, vld1q_s32(data + i));
+    }
+    return vaddvq_s32(acc) + sumScalar(data + i, count - i);
+}
+
+inline int dotNeon(const int *left, const int *right, std::size_t count){
+    int32x4_t acc = vdupq_n_s32(0);
+    std::size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        acc = vmlaq_s32(acc, vld1q_s32(left + i), vld1q_s32(right + i));
+    }
+    return vaddvq_s32(acc) + dotScalar(left + i, right + i, count - i);
+}
+
+inline int minNeon(const int *data, std::size_t count){
+    if(count < 4){
+        return minScalar(data, count);
+    }
+    int32x4_t acc = vld1q_s32(data);
+    std::size_t i = 4;
+    for(; i + 4 <= count; i += 4){
+        acc = vminq_s32(acc, vld1q_s32(data + i));
+    }
+    int result = vminvq_s32(acc);
+    return i < count ? std::min(result, minScalar(data + i, count - i)) : result;
+}
+
+inline int maxNeon(const int *data, std::size_t count){
+    if(count < 4){
+        return maxScalar(data, count);
+    }
+    int32x4_t acc = vld1q_s32(data);
+    std::size_t i = 4;
+    for(; i + 4 <= count; i += 4){
+        acc = vmaxq_s32(acc, vld1q_s32(data + i));
+    }
+    int result = vmaxvq_s32(acc);
+    return i < count ? std::max(result, maxScalar(data + i, count - i)) : result;
+}
+
+inline double sumNeon(const double *data, std::size_t count){
+    float64x2_t acc0 = vdupq_n_f64(0.0);
+    float64x2_t acc1 = vdupq_n_f64(0.0);
+    std::size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        acc0 = vaddq_f64(acc0, vld1q_f64(data + i));
+        acc1 = vaddq_f64(acc1, vld1q_f64(data + i + 2));
+    }
+    return vaddvq_f64(vaddq_f64(acc0, acc1)) + sumScalar(data + i, count - i);
+}
+
+inline double dotNeon(const double *left, const double *right, std::size_t count){
+    float64x2_t acc0 = vdupq_n_f64(0.0);
+    float64x2_t acc1 = vdupq_n_f64(0.0);
+    std::size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        acc0 = vfmaq_f64(acc0, vld1q_f64(left + i), vld1q_f64(right + i));
+        acc1 = vfmaq_f64(acc1, vld1q_f64(left + i + 2), vld1q_f64(right + i + 2));
+    }
+    return vaddvq_f64(vaddq_f64(acc0, acc1)) + dotScalar(left + i, right + i, count - i);
+}
+
+inline double minNeon(const double *data, std::size_t count){
+    if(count < 2){
+        return minScalar(data, count);
+    }
+    float64x2_t acc = vld1q_f64(data);
+    std::size_t i = 2;
+    for(; i + 2 <= count; i += 2){
+        acc = vminq_f64(acc, vld1q_f64(data + i));
+    }
+    double result = vminvq_f64(acc);
+    return i < count ? std::min(result, data[i]) : result;
+}
+
+inline double maxNeon(const double *data, std::size_t count){
+    if(count < 2){
+        return maxScalar(data, count);
+    }
+    float64x2_t acc = vld1q_f64(data);
+    std::size_t i = 2;
+    for(; i + 2 <= count; i += 2){
+        acc = vmaxq_f64(acc, vld1q_f64(data + i));
+    }
+    double result = vmaxvq_f64(acc);
+    return i < count ? std::max(result, data[i]) : result;
+}
+#endif
+
+//通用版本使用标量内核；int和double的非模板重载优先匹配，选择向量化内核
+template<typename T>
+T sum(const T *data, std::size_t count){
+    return sumScalar(data, count);
+}
+
+template<typename T>
+T dot(const T *left, const T *right, std::size_t count){
+    return dotScalar(left, right, count);
+}
+
+template<typename T>
+T min(const T *data, std::size_t count){
+    return minScalar(data, count);
+}
+
+template<typename T>
+T max(const T *data, std::size_t count){
+    return maxScalar(data, count);
+}
+
+#if REDUCTION_HAVE_AVX2 || REDUCTION_HAVE_NEON
+#if REDUCTION_HAVE_AVX2
+#define REDUCTION_DISPATCH(kernel, ...) return hasAvx2() ? kernel##Avx2(__VA_ARGS__) : kernel##Scalar(__VA_ARGS__)
+#else
+#define REDUCTION_DISPATCH(kernel, ...) return kernel##Neon(__VA_ARGS__)
+#endif
+
+inline int sum(const int *data, std::size_t count){
+    REDUCTION_DISPATCH(sum, data, count);
+}
+
+inline double sum(const double *data, std::size_t count){
+    REDUCTION_DISPATCH(sum, data, count);
+}
+
+inline int dot(const int *left, const int *right, std::size_t count){
+    REDUCTION_DISPATCH(dot, left, right, count);
+}
+
+inline double dot(const double *left, const double *right, std::size_t count){
+    REDUCTION_DISPATCH(dot, left, right, count);
+}
+
+inline int min(const int *data, std::size_t count){
+    REDUCTION_DISPATCH(min, data, count);
+}
+
+inline double min(const double *data, std::size_t count){
+    REDUCTION_DISPATCH(min, data, count);
+}
+
+inline int max(const int *data, std::size_t count){
+    REDUCTION_DISPATCH(max, data, count);
+}
+
+inline double max(const double *data, std::size_t count){
+    REDUCTION_DISPATCH(max, data, count);
+}
+
+#undef REDUCTION_DISPATCH
+#endif
+
+}
+
+template<typename T>
+class Iterator{
+    public:
+        virtual ~Iterator() = default;
+        virtual bool hasNext() = 0;
+        virtual T next() = 0;//返回迭代器当前元素并迭代到下一个
+
+        //批量取出最多maxCount个元素写入buffer，返回实际取出的个数
+        //默认实现逐个调用next()，具体迭代器可以重写为整块拷贝，把每元素一次的虚调用变为每批一次
+        virtual int nextBatch(T *buffer, int maxCount){
+            int count = 0;
+            while(count < maxCount && hasNext()){
+                buffer[count++] = next();
+            }
+            return count;
+        }
+};
+
+//小缓冲区迭代器句柄：迭代器对象直接构造在句柄内部的缓冲区里，放不下时才退回堆分配
+//句柄不可拷贝也不可移动，按值返回依赖C++17的强制复制消除
+template<typename T>
+class IteratorHandle{
+    private:
+        static constexpr std::size_t BufferSize = 4 * sizeof(void*);
+
+        alignas(std::max_align_t) unsigned char buffer[BufferSize];
+        Iterator<T> *iterator;
+        bool inlined;
+
+    protected:
+
+    public:
+        //在句柄内部就地构造具体迭代器It
+        template<typename It, typename... Args>
+        explicit IteratorHandle(std::in_place_type_t<It>, Args&&... args){
+            if constexpr(sizeof(It) <= BufferSize && alignof(It) <= alignof(std::max_align_t)){
+                iterator = new (buffer) It(std::forward<Args>(args)...);
+                inlined = true;
+            }else{
+                iterator = new It(std::forward<Args>(args)...);
+                inlined = false;
+            }
+        }
+
+        //接管一个已经在堆上创建的迭代器
+        explicit IteratorHandle(std::unique_ptr<Iterator<T>> heapIterator) : iterator(heapIterator.release()), inlined(false){}
+
+        IteratorHandle(const IteratorHandle&) = delete;
+        IteratorHandle& operator=(const IteratorHandle&) = delete;
+
+        ~IteratorHandle(){
+            if(inlined){
+                iterator->~Iterator<T>();
+            }else{
+                delete iterator;
+            }
+        }
+
+        bool isInline() const{
+            return inlined;
+        }
+
+        Iterator<T>* operator->() const{
+            return iterator;
+        }
+
+        Iterator<T>& operator*() const{
+            return *iterator;
+        }
+};
+
+template<typename T>
+class Aggregate{
+    public:
+        virtual ~Aggregate() = default;
+        virtual std::unique_ptr<Iterator<T>> createIterator() = 0;
+
+        virtual int size() const = 0;
+        virtual T get(int index) const = 0;
+
+        //不经过堆分配创建迭代器；默认实现只是包装createIterator()，子类应重写为就地构造
+        virtual IteratorHandle<T> createInlineIterator(){
+            return IteratorHandle<T>(createIterator());
+        }
+};
+
+template<typename T>
+class CustomCollection : public Aggregate<T>{
+    private:
+        std::vector<T> items;
+
+    protected:
+
+    public:
+
+        CustomCollection(){
+            LOG_DEBUG("CustomCollection created");
+        }
+
+        ~CustomCollection(){
+            LOG_DEBUG("CustomCollection destroyed");
+        }
+
+        void add(const T &item){
+            items.push_back(item);
+        }
+
+        //右值版本直接移动进集合，不拷贝
+        void add(T &&item){
+            items.push_back(std::move(item));
+        }
+
+        //就地构造元素，连移动都省掉
+        template<typename... Args>
+        T& emplace(Args&&... args){
+            return items.emplace_back(std::forward<Args>(args)...);
+        }
+
+        //预先分配容量，已知数量时只分配一次
+        void reserve(int capacity){
+            items.reserve(capacity);
+        }
+
+        //批量追加[first, last)；前向迭代器会一次性算出长度、只分配一次，配合std::make_move_iterator可以移动元素
+        template<typename InputIt>
+        void addAll(InputIt first, InputIt last){
+            items.insert(items.end(), first, last);
+        }
+
+        //批量追加另一个聚合对象的全部元素，先按对方的size()预留容量
+        void addAll(const Aggregate<T> &other){
+            int count = other.size();
+            items.reserve(items.size() + count);
+            if(auto *collection = dynamic_cast<const CustomCollection<T>*>(&other)){
+                if(collection != this){
+                    items.insert(items.end(), collection->items.begin(), collection->items.end());//同类型集合整段拷贝
+                    return;
+                }
+                //追加自身：容量已经预留，循环中不会重新分配，引用的元素始终有效
+                for(int i = 0; i < count; i++){
+                    items.push_back(items[i]);
+                }
+                return;
+            }
+            for(int i = 0; i < count; i++){
+                items.push_back(other.get(i));//get()按值返回，这里是移动而不是拷贝
+            }
+        }
+
+        int size() const override{
+            return items.size();
+        }
+
+        T get(int index) const override{
+            if(index >= 0 && index < items.size()){
+                return items[index];
+            }
+            throw std::out_of_range("Index out of range");
+        }
+
+        //算术类型的归约直接在底层数组上运行向量化内核，不经过迭代器
+        T sum() const{
+            static_assert(std::is_arithmetic_v<T>, "sum() requires an arithmetic element type");
+            return reduction::sum(items.data(), items.size());
+        }
+
+        T min() const{
+            static_assert(std::is_arithmetic_v<T>, "min() requires an arithmetic element type");
+            if(items.empty()){
+                throw std::out_of_range("Empty collection");
+            }
+            return reduction::min(items.data(), items.size());
+        }
+
+        T max() const{
+            static_assert(std::is_arithmetic_v<T>, "max() requires an arithmetic element type");
+            if(items.empty()){
+                throw std::out_of_range("Empty collection");
+            }
+            return reduction::max(items.data(), items.size());
+        }
+
+        //两个集合按下标逐个相乘再求和，长度必须相同
+        T dot(const CustomCollection<T> &other) const{
+            static_assert(std::is_arithmetic_v<T>, "dot() requires an arithmetic element type");
+            if(items.size() != other.items.size()){
+                throw std::invalid_argument("Collections differ in size");
+            }
+            return reduction::dot(items.data(), other.items.data(), items.size());
+        }
+
+        //简单的谓词（比较、取模等）在连续数组上会被编译器自动向量化
+        template<typename Pred>
+        int countIf(Pred pred) const{
+            static_assert(std::is_arithmetic_v<T>, "countIf() requires an arithmetic element type");
+            const T *data = items.data();
+            int count = 0;
+            for(std::size_t i = 0; i < items.size(); i++){
+                count += pred(data[i]) ? 1 : 0;
+            }
+            return count;
+        }
+
+        //STL风格的连续迭代器：直接返回底层数组指针，非虚、无堆分配，支持range-for
+        using const_iterator = const T*;
+
+        const_iterator begin() const{
+            return items.data();
+        }
+
+        const_iterator end() const{
+            return items.data() + items.size();
+        }
+
+        class ForwardIterator : public Iterator<T>{//内部类
+            private:
+                const CustomCollection<T> &collection;
+                int currentIndex;
+        
+            protected:
+        
+            public:
+                //列表初始化
+                ForwardIterator(const CustomCollection<T> &coll) : collection(coll), currentIndex(0){}
+        
+                bool hasNext() override{
+                    return currentIndex < collection.size();
+                }
+        
+                //hasNext()已经检查过下标，直接读items，不再经过get()的第二次越界检查
+                T next() override{
+                    if(!hasNext()){
+                        throw std::out_of_range("No more elements");
+                    }
+                    return collection.items[currentIndex++];
+                }
+
+                //返回元素的const引用，不拷贝；只有ITERATOR_CHECKED构建才做越界检查
+                const T& nextRef(){
+#if ITERATOR_CHECKED
+                    if(!hasNext()){
+                        throw std::out_of_range("No more elements");
+                    }
+#endif
+                    return collection.items[currentIndex++];
+                }
+
+                int nextBatch(T *buffer, int maxCount) override{
+                    int count = std::min(maxCount, collection.size() - currentIndex);
+                    if(count <= 0){
+                        return 0;
+                    }
+                    std::copy_n(collection.items.begin() + currentIndex, count, buffer);
+                    currentIndex += count;
+                    return count;
+                }
+        };
+
+        std::unique_ptr<Iterator<T>> createIterator() override{
+            return std::make_unique<ForwardIterator>(*this);
+        }
+
+        IteratorHandle<T> createInlineIterator() override{
+            return IteratorHandle<T>(std::in_place_type<ForwardIterator>, *this);
+        }
+
+        //可拆分迭代器（类似Java的Spliterator）：遍历[currentIndex, endIndex)，可以把剩余区间对半拆出去
+        class SplitIterator : public Iterator<T>{
+            private:
+                const CustomCollection<T> *collection;//用指针而不是引用，SplitIterator才能放进vector
+                int currentIndex;
+                int endIndex;
+
+            protected:
+
+            public:
+                SplitIterator(const CustomCollection<T> &coll, int begin, int end) : collection(&coll), currentIndex(begin), endIndex(end){}
+
+                bool hasNext() override{
+                    return currentIndex < endIndex;
+                }
+
+                T next() override{
+                    if(!hasNext()){
+                        throw std::out_of_range("No more elements");
+                    }
+                    return collection->items[currentIndex++];
+                }
+
+                const T& nextRef(){
+#if ITERATOR_CHECKED
+                    if(!hasNext()){
+                        throw std::out_of_range("No more elements");
+                    }
+#endif
+                    return collection->items[currentIndex++];
+                }
+
+                int nextBatch(T *buffer, int maxCount) override{
+                    int count = std::min(maxCount, endIndex - currentIndex);
+                    if(count <= 0){
+                        return 0;
+                    }
+                    std::copy_n(collection->items.begin() + currentIndex, count, buffer);
+                    currentIndex += count;
+                    return count;
+                }
+
+                //剩余元素个数；基于vector的区间是精确值
+                int estimateSize() const{
+                    return endIndex - currentIndex;
+                }
+
+                //把剩余区间的前一半拆成新的迭代器返回，自己保留后一半；剩余不足两个元素时不拆分
+                std::optional<SplitIterator> trySplit(){
+                    int remaining = endIndex - currentIndex;
+                    if(remaining < 2){
+                        return std::nullopt;
+                    }
+                    int middle = currentIndex + remaining / 2;
+                    SplitIterator prefix(*collection, currentIndex, middle);
+                    currentIndex = middle;
+                    return prefix;
+                }
+
+                //对剩余元素逐个调用func(const T&)，直接走底层数组，没有虚调用
+                template<typename Func>
+                void forEachRemaining(Func &&func){
+                    const T *data = collection->items.data();
+                    for(int i = currentIndex; i < endIndex; i++){
+                        func(data[i]);
+                    }
+                    currentIndex = endIndex;
+                }
+        };
+
+        SplitIterator createSplitIterator() const{
+            return SplitIterator(*this, 0, size());
+        }
+
+        //只读并行遍历：把集合拆成若干子区间分给线程池，调用方线程也参与处理
+        //func会被多个线程同时调用，必须是线程安全的；每个子区间至少minChunk个元素
+        template<typename Func>
+        void parallelForEach(Func func, ThreadPool &pool = ThreadPool::shared(), int minChunk = 4096) const{
+            //拆分到每个线程约4个子区间，便于先做完的线程继续领取，平衡负载
+            //minChunk不大于0时按1处理，否则不足两个元素的子区间也会被拆分
+            minChunk = std::max(minChunk, 1);
+            std::size_t targetPieces = pool.size() * 4;
+            std::vector<SplitIterator> pieces;
+            pieces.push_back(createSplitIterator());
+            bool splitted = true;
+            while(splitted && pieces.size() < targetPieces){
+                splitted = false;
+                std::size_t count = pieces.size();
+                for(std::size_t i = 0; i < count && pieces.size() < targetPieces; i++){
+                    if(pieces[i].estimateSize() < 2 * minChunk){
+                        continue;
+                    }
+                    if(std::optional<SplitIterator> prefix = pieces[i].trySplit()){
+                        pieces.push_back(*prefix);
+                        splitted = true;
+                    }
+                }
+            }
+
+            //领取、等待和重新抛出异常由线程池完成
+            pool.forEachChunk(pieces.size(), [&pieces, &func](std::size_t index, std::size_t){
+                pieces[index].forEachRemaining(func);
+            });
+        }
+};
+
+//只读的连续数组视图，SoACollection用它暴露单个字段
+template<typename T>
+class ColumnView{
+    private:
+        const T *first;
+        const T *last;
+
+    public:
+        ColumnView(const T *first, const T *last) : first(first), last(last){}
+
+        const T* begin() const{
+            return first;
+        }
+
+        const T* end() const{
+            return last;
+        }
+
+        int size() const{
+            return last - first;
+        }
+
+        const T& operator[](int index) const{
+            return first[index];
+        }
+};
+
+//结构体数组（Structure of Arrays）集合：每个字段单独存放在一段连续数组中，字段列表由模板参数在编译期给出
+//作为Aggregate时每个元素是std::tuple<Fields...>；只关心一两个字段的扫描用column<I>()，只读取对应的那几列
+template<typename... Fields>
+class SoACollection : public Aggregate<std::tuple<Fields...>>{
+    static_assert(sizeof...(Fields) > 0, "SoACollection needs at least one field");
+    static_assert(!std::disjunction_v<std::is_same<Fields, bool>...>, "std::vector<bool> is not contiguous, use char instead");
+
+    public:
+        using Row = std::tuple<Fields...>;
+
+        template<std::size_t I>
+        using FieldType = std::tuple_element_t<I, Row>;
+
+    private:
+        std::tuple<std::vector<Fields>...> columns;
+
+        template<std::size_t... I>
+        void push(std::index_sequence<I...>, const Fields&... values){
+            (std::get<I>(columns).push_back(values), ...);
+        }
+
+        template<std::size_t... I>
+        Row row(int index, std::index_sequence<I...>) const{
+            return Row(std::get<I>(columns)[index]...);
+        }
+
+    protected:
+
+    public:
+        SoACollection(){
+            LOG_DEBUG("SoACollection created");
+        }
+
+        ~SoACollection(){
+            LOG_DEBUG("SoACollection destroyed");
+        }
+
+        void add(const Fields&... values){
+            push(std::index_sequence_for<Fields...>(), values...);
+        }
+
+        void reserve(int capacity){
+            std::apply([capacity](auto&... column){ (column.reserve(capacity), ...); }, columns);
+        }
+
+        int size() const override{
+            return std::get<0>(columns).size();
+        }
+
+        //按行取出时需要从每一列各读一次，组装成tuple
+        Row get(int index) const override{
+            if(index >= 0 && index < size()){
+                return row(index, std::index_sequence_for<Fields...>());
+            }
+            throw std::out_of_range("Index out of range");
+        }
+
+        //第I个字段的连续视图，begin()/end()就是该字段的迭代器
+        template<std::size_t I>
+        ColumnView<FieldType<I>> column() const{
+            const auto &values = std::get<I>(columns);
+            return ColumnView<FieldType<I>>(values.data(), values.data() + values.size());
+        }
+
+        class ForwardIterator : public Iterator<Row>{
+            private:
+                const SoACollection &collection;
+                int currentIndex;
+
+            protected:
+
+            public:
+                ForwardIterator(const SoACollection &coll) : collection(coll), currentIndex(0){}
+
+                bool hasNext() override{
+                    return currentIndex < collection.size();
+                }
+
+                Row next() override{
+                    if(!hasNext()){
+                        throw std::out_of_range("No more elements");
+                    }
+                    return collection.row(currentIndex++, std::index_sequence_for<Fields...>());
+                }
+        };
+
+        std::unique_ptr<Iterator<Row>> createIterator() override{
+            return std::make_unique<ForwardIterator>(*this);
+        }
+
+        IteratorHandle<Row> createInlineIterator() override{
+            return IteratorHandle<Row>(std::in_place_type<ForwardIterator>, *this);
+        }
+};
+
+//惰性迭代适配器：每个阶段只保存上游阶段和自己的函数对象，next()时按需从上游拉取
+//整条流水线在一次遍历中完成，不产生中间集合，也没有堆分配
+//每个阶段都提供hasNext()/next()，hasNext()可以重复调用
+//next()越界时抛出std::out_of_range：FilterStage、TakeStage、SkipStage本来就要先调用hasNext()，总是检查；
+//其他阶段只在ITERATOR_CHECKED构建中检查，否则调用方必须先用hasNext()确认
+
+//从一对STL迭代器（例如CustomCollection::begin()/end()）拉取，next()返回元素的引用
+template<typename It>
+class RangeSource{
+    private:
+        It current;
+        It last;
+
+    public:
+        RangeSource(It first, It last) : current(first), last(last){}
+
+        bool hasNext(){
+            return current != last;
+        }
+
+        decltype(auto) next(){
+#if ITERATOR_CHECKED
+            if(!hasNext()){
+                throw std::out_of_range("No more elements");
+            }
+#endif
+            return *current++;
+        }
+};
+
+//从抽象的Iterator<T>拉取，每个元素仍是一次虚调用
+template<typename T>
+class IteratorSource{
+    private:
+        Iterator<T> *iterator;
+
+    public:
+        explicit IteratorSource(Iterator<T> &iterator) : iterator(&iterator){}
+
+        bool hasNext(){
+            return iterator->hasNext();
+        }
+
+        T next(){
+            return iterator->next();
+        }
+};
+
+//上游next()的返回类型，可能是引用
+template<typename Source>
+using SourceReference = decltype(std::declval<Source&>().next());
+
+//上游元素去掉引用和const后的值类型
+template<typename Source>
+using SourceValue = std::decay_t<SourceReference<Source>>;
+
+//FilterStage预取一个元素时的暂存位置：上游返回左值引用时只存指针，返回值时才存一份值
+template<typename Reference, bool = std::is_lvalue_reference<Reference>::value>
+class LookaheadSlot{
+    private:
+        std::remove_reference_t<Reference> *pointer = nullptr;
+
+    public:
+        bool has() const{
+            return pointer != nullptr;
+        }
+
+        void put(Reference value){
+            pointer = &value;
+        }
+
+        Reference take(){
+            Reference value = *pointer;
+            pointer = nullptr;
+            return value;
+        }
+};
+
+template<typename Reference>
+class LookaheadSlot<Reference, false>{
+    private:
+        std::optional<std::decay_t<Reference>> value;
+
+    public:
+        bool has() const{
+            return value.has_value();
+        }
+
+        void put(Reference &&item){
+            value.emplace(std::move(item));
+        }
+
+        std::decay_t<Reference> take(){
+            std::decay_t<Reference> item = std::move(*value);
+            value.reset();
+            return item;
+        }
+};
+
+template<typename Source, typename Pred>
+class FilterStage{
+    private:
+        Source source;
+        Pred pred;
+        LookaheadSlot<SourceReference<Source>> slot;
+
+    public:
+        FilterStage(Source source, Pred pred) : source(std::move(source)), pred(std::move(pred)){}
+
+        bool hasNext(){
+            while(!slot.has() && source.hasNext()){
+                SourceReference<Source> &&item = source.next();
+                if(pred(item)){
+                    slot.put(std::forward<SourceReference<Source>>(item));
+                }
+            }
+            return slot.has();
+        }
+
+        decltype(auto) next(){
+            if(!hasNext()){
+                throw std::out_of_range("No more elements");
+            }
+            return slot.take();
+        }
+};
+
+template<typename Source, typename Func>
+class MapStage{
+    private:
+        Source source;
+        Func func;
+
+    public:
+        MapStage(Source source, Func func) : source(std::move(source)), func(std::move(func)){}
+
+        bool hasNext(){
+            return source.hasNext();
+        }
+
+        decltype(auto) next(){
+#if ITERATOR_CHECKED
+            if(!hasNext()){
+                throw std::out_of_range("No more elements");
+            }
+#endif
+            return func(source.next());
+        }
+};
+
+template<typename Source>
+class TakeStage{
+    private:
+        Source source;
+        int remaining;
+
+    public:
+        TakeStage(Source source, int count) : source(std::move(source)), remaining(count){}
+
+        bool hasNext(){
+            return remaining > 0 && source.hasNext();
+        }
+
+        decltype(auto) next(){
+            if(!hasNext()){
+                throw std::out_of_range("No more elements");
+            }
+            remaining--;
+            return source.next();
+        }
+};
+
+template<typename Source>
+class SkipStage{
+    private:
+        Source source;
+        int toSkip;
+
+    public:
+        SkipStage(Source source, int count) : source(std::move(source)), toSkip(count){}
+
+        //第一次被询问时才丢弃前toSkip个元素
+        bool hasNext(){
+            while(toSkip > 0 && source.hasNext()){
+                source.next();
+                toSkip--;
+            }
+            return source.hasNext();
+        }
+
+        decltype(auto) next(){
+            if(!hasNext()){
+                throw std::out_of_range("No more elements");
+            }
+            return source.next();
+        }
+};
+
+//两个上游同步前进，任意一个结束即结束；元素为std::pair，上游返回引用时pair中也是引用
+template<typename First, typename Second>
+class ZipStage{
+    private:
+        First first;
+        Second second;
+
+    public:
+        ZipStage(First first, Second second) : first(std::move(first)), second(std::move(second)){}
+
+        bool hasNext(){
+            return first.hasNext() && second.hasNext();
+        }
+
+        std::pair<SourceReference<First>, SourceReference<Second>> next(){
+#if ITERATOR_CHECKED
+            if(!hasNext()){
+                throw std::out_of_range("No more elements");
+            }
+#endif
+            SourceReference<First> &&left = first.next();
+            SourceReference<Second> &&right = second.next();
+            return std::pair<SourceReference<First>, SourceReference<Second>>(
+                std::forward<SourceReference<First>>(left), std::forward<SourceReference<Second>>(right));
+        }
+};
+
+//固定容量的分块，存放在栈上的std::array里；最后一块的count可能小于N
+template<typename V, std::size_t N>
+struct Chunk{
+    std::array<V, N> items;
+    std::size_t count = 0;
+
+    const V* begin() const{
+        return items.data();
+    }
+
+    const V* end() const{
+        return items.data() + count;
+    }
+};
+
+template<typename Source, std::size_t N>
+class ChunkStage{
+    private:
+        Source source;
+
+    public:
+        explicit ChunkStage(Source source) : source(std::move(source)){}
+
+        bool hasNext(){
+            return source.hasNext();
+        }
+
+        Chunk<SourceValue<Source>, N> next(){
+#if ITERATOR_CHECKED
+            if(!hasNext()){
+                throw std::out_of_range("No more elements");
+            }
+#endif
+            Chunk<SourceValue<Source>, N> chunk;
+            while(chunk.count < N && source.hasNext()){
+                chunk.items[chunk.count++] = source.next();
+            }
+            return chunk;
+        }
+};
+
+//流水线的链式入口：每个适配方法返回包装了新阶段的Pipeline，终结方法负责真正的遍历
+template<typename Source>
+class Pipeline{
+    private:
+        Source source;
+
+    public:
+        explicit Pipeline(Source source) : source(std::move(source)){}
+
+        bool hasNext(){
+            return source.hasNext();
+        }
+
+        decltype(auto) next(){
+            return source.next();
+        }
+
+        template<typename Pred>
+        Pipeline<FilterStage<Source, Pred>> filter(Pred pred) const{
+            return Pipeline<FilterStage<Source, Pred>>(FilterStage<Source, Pred>(source, std::move(pred)));
+        }
+
+        template<typename Func>
+        Pipeline<MapStage<Source, Func>> map(Func func) const{
+            return Pipeline<MapStage<Source, Func>>(MapStage<Source, Func>(source, std::move(func)));
+        }
+
+        Pipeline<TakeStage<Source>> take(int count) const{
+            return Pipeline<TakeStage<Source>>(TakeStage<Source>(source, count));
+        }
+
+        Pipeline<SkipStage<Source>> skip(int count) const{
+            return Pipeline<SkipStage<Source>>(SkipStage<Source>(source, count));
+        }
+
+        template<typename Other>
+        Pipeline<ZipStage<Source, Other>> zip(const Pipeline<Other> &other) const{
+            return Pipeline<ZipStage<Source, Other>>(ZipStage<Source, Other>(source, other.source));
+        }
+
+        template<std::size_t N>
+        Pipeline<ChunkStage<Source, N>> chunk() const{
+            return Pipeline<ChunkStage<Source, N>>(ChunkStage<Source, N>(source));
+        }
+
+        //终结操作：驱动整条流水线
+        template<typename Func>
+        void forEach(Func func){
+            while(source.hasNext()){
+                func(source.next());
+            }
+        }
+
+        template<typename U, typename Op>
+        U reduce(U init, Op op){
+            while(source.hasNext()){
+                init = op(std::move(init), source.next());
+            }
+            return init;
+        }
+
+        int count(){
+            int result = 0;
+            while(source.hasNext()){
+                source.next();
+                result++;
+            }
+            return result;
+        }
+
+        //把结果追加到已有的集合中，这是整条流水线唯一会分配内存的地方
+        template<typename Collection>
+        void collectInto(Collection &out){
+            while(source.hasNext()){
+                out.add(source.next());
+            }
+        }
+
+        template<typename Other>
+        friend class Pipeline;
+};
+
+template<typename T>
+Pipeline<RangeSource<const T*>> lazy(const CustomCollection<T> &collection){
+    return Pipeline<RangeSource<const T*>>(RangeSource<const T*>(collection.begin(), collection.end()));
+}
+
+template<typename T>
+Pipeline<IteratorSource<T>> lazy(Iterator<T> &iterator){
+    return Pipeline<IteratorSource<T>>(IteratorSource<T>(iterator));
+}
+
+template<typename It>
+Pipeline<RangeSource<It>> lazy(It first, It last){
+    return Pipeline<RangeSource<It>>(RangeSource<It>(first, last));
+}
+
+#endif
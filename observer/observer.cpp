@@ -1,117 +1,117 @@
-#include <iostream>
-#include <vector>
-#include <memory>
-#include <algorithm>
+#include "observer.h"
 
-class Observer;
-
-
-class Subject{
-    private:
-
-    protected:
-
-    public:
-        virtual ~Subject() = default;
-        virtual void attach(Observer* observer) = 0;
-        virtual void detach(Observer* observer) = 0;
-        virtual void notify() = 0;
-        virtual int getState() const = 0;
-};
-
-class Observer{
-    private:
-
-    protected:
-
-    public:
-        virtual ~Observer() = default;
-        virtual void update(Subject* subject) = 0;
+//推模型示例中的事件
+struct StateChanged{
+    int state;
 };
 
-class ConcreteSubject : public Subject{
+class StateObserver final : public EventObserver<StateChanged>{
     private:
         int state;
-        std::vector<Observer*> observers;
 
     protected:
 
     public:
-        ConcreteSubject(){
-            std::cout << "ConcreteSubject created" << std::endl;
-        }
-
-        ~ConcreteSubject(){
-            std::cout << "ConcreteSubject destroyed" << std::endl;
-        }
-
-        void attach(Observer* observer) override{
-            observers.push_back(observer);
-        }
-
-        void detach(Observer* observer) override{
-            observers.erase(
-                std::remove_if(observers.begin(), observers.end(),
-                    [observer](Observer* ptr) {
-                        return ptr == observer;
-                    }),
-                observers.end()
-            );
+        StateObserver() : state(0){
+            LOG_DEBUG("StateObserver created");
         }
 
-        void notify() override{
-            for(auto& observer : observers){
-                observer->update(this);
-            }
+        ~StateObserver(){
+            LOG_DEBUG("StateObserver destroyed");
         }
 
-        void setState(int state){
-            this->state = state;
-        }
-
-        int getState() const override {
-            return state;
+        void update(const StateChanged& event) override{
+            this->state = event.state;
+            LOG_INFO("StateObserver updated: ", this->state);
         }
 };
 
-class ConcreteObserver : public Observer{
-    private:
-        int state;
-
-    protected:
-
-    public:
-        ConcreteObserver(){
-            std::cout << "ConcreteObserver created" << std::endl;
-        }
-
-        ~ConcreteObserver(){
-            std::cout << "ConcreteObserver destroyed" << std::endl;
-        }
-
-        void update(Subject* subject) override{
-            if (auto* concreteSubject = dynamic_cast<ConcreteSubject*>(subject)) {
-                this->state = concreteSubject->getState();
-                std::cout << "ConcreteObserver updated: " << this->state << std::endl;
-            }
-        }
-
-
-};
-
 int main(){
 
     ConcreteSubject subject;
     ConcreteObserver observer1;
     ConcreteObserver observer2;
-    subject.attach(&observer1);
+    Subscription subscription1 = subject.attach(&observer1);
     subject.attach(&observer2);
     subject.setState(1);
     subject.notify();
-    subject.detach(&observer1);
+    subject.detach(subscription1);
     subject.setState(2);
     subject.notify();
+    subject.setState(2);
+    subject.notify();//状态没有变化，不会通知
+    {
+        ConcreteSubject::UpdateScope scope(subject);
+        subject.setState(3);
+        subject.notify();
+        subject.setState(4);
+        subject.notify();
+    }//只通知一次：4
+    {
+        auto observer3 = std::make_shared<ConcreteObserver>();
+        subject.attach(observer3);
+        subject.setState(5);
+        subject.notify();
+    }//observer3已经销毁，不需要detach()
+    subject.setState(6);
+    subject.notify();//失效的订阅在这次通知中被清除
+    //以-DMETRICS_ENABLED=1编译时输出subject的统计；观察者的直方图随订阅释放，所以在detach()之前导出
+    METRICS_ONLY(metrics::LogExporter exporter;)
+    METRICS_ONLY(subject.statistics().exportTo(exporter);)
     subject.detach(&observer2);
 
+    {
+        ConcurrentSubject concurrentSubject;
+        concurrentSubject.attach(&observer1);
+        Subscription subscription2 = concurrentSubject.attach(&observer2);
+        concurrentSubject.setState(3);
+        concurrentSubject.notify();
+        concurrentSubject.detach(subscription2);
+        concurrentSubject.detach(&observer1);
+    }
+
+    {
+        AsyncSubject asyncSubject(BackpressurePolicy::Block, 4);
+        asyncSubject.attach(&observer1);
+        asyncSubject.setState(4);
+        asyncSubject.setState(5);
+        asyncSubject.waitIdle();
+        asyncSubject.detach(&observer1);
+    }
+
+    {
+        EventBus bus(2);
+        BusSubject busSubject(bus);
+        busSubject.attach(&observer1);
+        busSubject.attach(&observer2);
+        busSubject.setState(11);
+        busSubject.notify();
+        busSubject.setState(12);
+        busSubject.notify();//同一主题的事件按顺序投递：11, 11, 12, 12
+        bus.waitIdle();
+    }
+
+    {
+        StateObserver stateObserver1;
+        StateObserver stateObserver2;
+        EventSubject<StateChanged> eventSubject;
+        eventSubject.attach(&stateObserver1);
+        eventSubject.notify(StateChanged{6});
+        eventSubject.detach(&stateObserver1);
+
+        auto staticSubject = makeStaticEventSubject<StateChanged>(stateObserver1, stateObserver2);
+        staticSubject.notify(StateChanged{7});
+
+        TopicSubject<StateChanged> topicSubject;
+        topicSubject.attach(&stateObserver1, 1);//只关心主题1
+        topicSubject.attachIf(&stateObserver2, [](const StateChanged& event){ return event.state >= 10; }, 5);
+        topicSubject.notify(1, StateChanged{8});//只有stateObserver1
+        topicSubject.notify(2, StateChanged{9});//没有订阅者
+        topicSubject.notify(1, StateChanged{10});//stateObserver2优先级更高，先收到
+    }
+
+    //输出仍然存活的主题的统计
+    METRICS_ONLY(metrics::Registry::instance().exportAll(exporter);)
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,1559 @@
+#ifndef OBSERVER_OBSERVER_H
+#define OBSERVER_OBSERVER_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <tuple>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include "../common/log.h"
+#include "../common/metrics.h"
+#include "../common/thread_pool.h"
+
+class Observer;
+
+//订阅句柄：slot是槽位下标，generation用来识别槽位被复用之后的过期句柄
+struct Subscription{
+    std::uint32_t slot;
+    std::uint32_t generation;
+};
+
+//不使用槽位映射的主题给每个订阅分配只增不减的64位编号，拆成句柄的两个字段，编号不会复用
+inline Subscription subscriptionFromId(std::uint64_t id){
+    return Subscription{static_cast<std::uint32_t>(id), static_cast<std::uint32_t>(id >> 32)};
+}
+
+inline std::uint64_t idFromSubscription(Subscription subscription){
+    return (static_cast<std::uint64_t>(subscription.generation) << 32) | subscription.slot;
+}
+
+//槽位映射（slot map）：entries是紧凑的连续数组，供notify()顺序遍历；
+//每个槽位记录对应订阅在entries中的下标，删除时把最后一个元素换到空位上（swap-and-pop），增删都是O(1)
+//代价是删除后剩余订阅的顺序可能改变
+//
+//遍历期间（forEach回调中）的增删会被推迟：删除只把元素标记为已删除，新增先放进pending列表，
+//最外层遍历结束后再统一整理。这样回调里注销自己或注册新观察者都是安全的，而没有修改时遍历不需要任何拷贝或分配
+template<typename Entry>
+class SubscriptionList{
+    private:
+        static constexpr std::uint32_t Dead = UINT32_MAX;//entrySlots中的删除标记
+        static constexpr std::uint32_t PendingBit = 1u << 31;//槽位下标带这一位时指向pendingEntries
+
+        struct Slot{
+            std::uint32_t index;//在entries（或pendingEntries）中的下标
+            std::uint32_t generation;
+        };
+
+        std::vector<Entry> entries;
+        std::vector<std::uint32_t> entrySlots;//entries[i]对应的槽位
+        std::vector<Entry> pendingEntries;//遍历期间新增、尚未并入entries的订阅
+        std::vector<std::uint32_t> pendingSlots;
+        std::vector<Slot> slots;
+        std::vector<std::uint32_t> freeSlots;
+        std::size_t liveCount = 0;
+        int iterating = 0;//forEach嵌套深度
+        bool hasDead = false;
+
+        std::uint32_t allocateSlot(){
+            if(freeSlots.empty()){
+                slots.push_back(Slot{0, 0});
+                return static_cast<std::uint32_t>(slots.size() - 1);
+            }
+            std::uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+
+        void releaseSlot(std::uint32_t slot){
+            slots[slot].generation++;//旧句柄从此失效
+            freeSlots.push_back(slot);
+            liveCount--;
+        }
+
+        void removeAt(std::size_t index){
+            std::uint32_t slot = entrySlots[index];
+            releaseSlot(slot);
+            if(iterating > 0){
+                entrySlots[index] = Dead;
+                hasDead = true;
+                return;
+            }
+            erase(index);
+        }
+
+        void removePendingAt(std::size_t index){
+            releaseSlot(pendingSlots[index]);
+            pendingSlots[index] = Dead;
+        }
+
+        //swap-and-pop，调用前槽位已经释放或标记为已删除
+        void erase(std::size_t index){
+            std::size_t last = entries.size() - 1;
+            if(index != last){
+                entries[index] = std::move(entries[last]);
+                entrySlots[index] = entrySlots[last];
+                if(entrySlots[index] != Dead){
+                    slots[entrySlots[index]].index = static_cast<std::uint32_t>(index);
+                }
+            }
+            entries.pop_back();
+            entrySlots.pop_back();
+        }
+
+        //最外层遍历结束后：清除已删除的元素，再把pending中的订阅并入entries
+        void applyDeferred(){
+            if(hasDead){
+                for(std::size_t i = entries.size(); i-- > 0;){
+                    if(entrySlots[i] == Dead){
+                        erase(i);
+                    }
+                }
+                hasDead = false;
+            }
+            for(std::size_t i = 0; i < pendingEntries.size(); i++){
+                if(pendingSlots[i] != Dead){
+                    slots[pendingSlots[i]].index = static_cast<std::uint32_t>(entries.size());
+                    entries.push_back(std::move(pendingEntries[i]));
+                    entrySlots.push_back(pendingSlots[i]);
+                }
+            }
+            pendingEntries.clear();
+            pendingSlots.clear();
+        }
+
+        //回调抛出异常时也要恢复嵌套深度并整理推迟的修改
+        struct IterationScope{
+            SubscriptionList &list;
+
+            explicit IterationScope(SubscriptionList &list) : list(list){
+                list.iterating++;
+            }
+
+            ~IterationScope(){
+                if(--list.iterating == 0){
+                    list.applyDeferred();
+                }
+            }
+        };
+
+    protected:
+
+    public:
+        //遍历期间新增的订阅要等这一轮遍历结束后才会被访问到
+        Subscription add(Entry entry){
+            std::uint32_t slot = allocateSlot();
+            liveCount++;
+            if(iterating > 0){
+                slots[slot].index = PendingBit | static_cast<std::uint32_t>(pendingEntries.size());
+                pendingEntries.push_back(std::move(entry));
+                pendingSlots.push_back(slot);
+            }else{
+                slots[slot].index = static_cast<std::uint32_t>(entries.size());
+                entries.push_back(std::move(entry));
+                entrySlots.push_back(slot);
+            }
+            return Subscription{slot, slots[slot].generation};
+        }
+
+        bool contains(Subscription subscription) const{
+            return subscription.slot < slots.size() && slots[subscription.slot].generation == subscription.generation;
+        }
+
+        //句柄已经失效时返回false
+        bool remove(Subscription subscription){
+            if(!contains(subscription)){
+                return false;
+            }
+            std::uint32_t index = slots[subscription.slot].index;
+            if(index & PendingBit){
+                removePendingAt(index & ~PendingBit);
+            }else{
+                removeAt(index);
+            }
+            return true;
+        }
+
+        //删除所有满足pred的订阅（包括遍历期间新增、尚未并入的订阅），返回删除的个数
+        template<typename Pred>
+        std::size_t removeIf(Pred pred){
+            std::size_t removed = 0;
+            //从后往前扫描，swap-and-pop换过来的元素都已经检查过
+            for(std::size_t i = entries.size(); i-- > 0;){
+                if(entrySlots[i] != Dead && pred(entries[i])){
+                    removeAt(i);
+                    removed++;
+                }
+            }
+            for(std::size_t i = 0; i < pendingEntries.size(); i++){
+                if(pendingSlots[i] != Dead && pred(pendingEntries[i])){
+                    removePendingAt(i);
+                    removed++;
+                }
+            }
+            return removed;
+        }
+
+        //依次对每个有效订阅调用func(Entry&)；遍历开始后新增的订阅不会在本轮被访问，已删除的会被跳过
+        template<typename Func>
+        void forEach(Func &&func){
+            IterationScope scope(*this);
+            std::size_t count = entries.size();//遍历期间entries不会增长，也不会重新分配
+            for(std::size_t i = 0; i < count; i++){
+                if(entrySlots[i] != Dead){
+                    func(entries[i]);
+                }
+            }
+        }
+
+        //和forEach相同，但func(Entry&)返回false时就地删除该订阅（例如弱引用已经失效），
+        //删除推迟到最外层遍历结束后和其他推迟的修改一起整理，不需要额外的一遍扫描
+        template<typename Func>
+        void forEachOrRemove(Func &&func){
+            IterationScope scope(*this);
+            std::size_t count = entries.size();
+            for(std::size_t i = 0; i < count; i++){
+                if(entrySlots[i] != Dead && !func(entries[i])){
+                    if(entrySlots[i] != Dead){//回调中可能已经注销了自己
+                        removeAt(i);
+                    }
+                }
+            }
+        }
+
+        //有效订阅的个数
+        std::size_t size() const{
+            return liveCount;
+        }
+};
+
+//写时复制快照的发布点（AsyncSubject的邮箱列表）：load()取得当前快照，store()发布新快照
+//std::atomic_load/std::atomic_store(shared_ptr)在libstdc++中并不是无锁的，而是使用全进程共享的一组互斥量；
+//这里每个发布点用自己的互斥量，临界区内只有一次引用计数增减，读端不会等待写端复制列表，不同主题之间也不会相互竞争
+template<typename T>
+class SnapshotPtr{
+    private:
+        mutable std::mutex mutex;
+        std::shared_ptr<const T> current;
+
+    protected:
+
+    public:
+        explicit SnapshotPtr(std::shared_ptr<const T> initial) : current(std::move(initial)){}
+
+        std::shared_ptr<const T> load() const{
+            std::lock_guard<std::mutex> lock(mutex);
+            return current;
+        }
+
+        void store(std::shared_ptr<const T> next){
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current.swap(next);
+            }
+            //旧快照在锁外释放
+        }
+};
+
+class Subject{
+    private:
+
+    protected:
+
+    public:
+        virtual ~Subject() = default;
+        virtual Subscription attach(Observer* observer) = 0;
+        virtual void detach(Observer* observer) = 0;//按指针查找，O(n)
+        virtual void detach(Subscription subscription) = 0;//按句柄删除，O(1)
+        virtual void notify() = 0;
+        virtual int getState() const = 0;
+};
+
+class Observer{
+    private:
+
+    protected:
+
+    public:
+        virtual ~Observer() = default;
+        virtual void update(Subject* subject) = 0;
+};
+
+class ConcreteSubject : public Subject{
+    private:
+        //weak为空表示按裸指针注册，由调用者负责在观察者销毁前detach()；
+        //按weak_ptr注册时observer只用于按指针detach()，通知前先lock()
+        struct Registration{
+            Observer* observer;
+            std::weak_ptr<Observer> weak;
+            bool isWeak;
+            METRICS_ONLY(std::shared_ptr<metrics::LatencyHistogram> latency = nullptr;)
+        };
+
+        int state;
+        SubscriptionList<Registration> observers;
+        int lastNotifiedState;//上一次通知时的状态
+        bool notifiedOnce;
+        bool forceDirty;
+        int changeThreshold;//状态变化的绝对值超过它才算变化
+        int updateDepth;//beginUpdate()嵌套深度
+        METRICS_ONLY(metrics::SubjectMetrics stats{"ConcreteSubject"};)
+
+        void deliver([[maybe_unused]] const Registration& registration, Observer* observer){
+            METRICS_ONLY(std::uint64_t start = metrics::nowNanos();)
+            observer->update(this);
+            METRICS_ONLY(registration.latency->recordSince(start);)
+            METRICS_ONLY(stats.countDeliveries();)
+        }
+
+    protected:
+
+    public:
+        //RAII形式的批量更新范围，析构时调用endUpdate()
+        class UpdateScope{
+            private:
+                ConcreteSubject &subject;
+
+            public:
+                explicit UpdateScope(ConcreteSubject &subject) : subject(subject){
+                    subject.beginUpdate();
+                }
+
+                ~UpdateScope(){
+                    subject.endUpdate();
+                }
+
+                UpdateScope(const UpdateScope&) = delete;
+                UpdateScope& operator=(const UpdateScope&) = delete;
+        };
+
+        ConcreteSubject() : state(0), lastNotifiedState(0), notifiedOnce(false), forceDirty(false), changeThreshold(0), updateDepth(0){
+            LOG_DEBUG("ConcreteSubject created");
+        }
+
+        ~ConcreteSubject(){
+            LOG_DEBUG("ConcreteSubject destroyed");
+        }
+
+        Subscription attach(Observer* observer) override{
+            Registration registration{observer, {}, false};
+            METRICS_ONLY(registration.latency = stats.track(observer);)
+            return observers.add(std::move(registration));
+        }
+
+        //弱引用注册：观察者销毁后不需要detach()，失效的订阅会在之后的notify()中顺带清除
+        Subscription attach(const std::weak_ptr<Observer>& observer){
+            Registration registration{observer.lock().get(), observer, true};
+            METRICS_ONLY(registration.latency = stats.track(registration.observer);)
+            return observers.add(std::move(registration));
+        }
+
+        void detach(Observer* observer) override{
+            observers.removeIf([observer](const Registration& registration) {
+                return registration.observer == observer;
+            });
+        }
+
+        void detach(Subscription subscription) override{
+            observers.remove(subscription);
+        }
+
+        //状态相对上一次通知没有变化（或变化不超过阈值）时直接返回；批量更新范围内只记下，等endUpdate()时统一通知
+        //update()中attach/detach是安全的：修改推迟到本轮通知结束后生效
+        void notify() override{
+            if(updateDepth > 0 || !isDirty()){
+                METRICS_ONLY(stats.countCoalesced();)
+                return;
+            }
+            lastNotifiedState = state;
+            notifiedOnce = true;
+            forceDirty = false;
+            METRICS_ONLY(stats.countNotify();)
+            observers.forEachOrRemove([this](Registration& registration){
+                if(!registration.isWeak){
+                    deliver(registration, registration.observer);
+                    return true;
+                }
+                //lock()得到的shared_ptr保证update()期间观察者不会被销毁
+                std::shared_ptr<Observer> observer = registration.weak.lock();
+                if(!observer){
+                    return false;
+                }
+                deliver(registration, observer.get());
+                return true;
+            });
+        }
+
+        void setState(int state){
+            this->state = state;
+        }
+
+        int getState() const override {
+            return state;
+        }
+
+        METRICS_ONLY(const metrics::SubjectMetrics& statistics() const{ return stats; })
+
+        //订阅个数，包括尚未在notify()中清除的失效弱引用
+        std::size_t size() const{
+            return observers.size();
+        }
+
+        //从未通知过、被markDirty()标记过，或者状态与上一次通知时相差超过阈值
+        bool isDirty() const{
+            if(!notifiedOnce || forceDirty){
+                return true;
+            }
+            long long change = static_cast<long long>(state) - lastNotifiedState;
+            return (change < 0 ? -change : change) > changeThreshold;
+        }
+
+        //即使状态没有变化，下一次notify()也照常通知
+        void markDirty(){
+            forceDirty = true;
+        }
+
+        //阈值为0时任何变化都会通知，为负数时每次notify()都会通知
+        void setChangeThreshold(int threshold){
+            changeThreshold = threshold;
+        }
+
+        //beginUpdate()/endUpdate()之间的setState()/notify()合并为一次通知，可以嵌套
+        void beginUpdate(){
+            updateDepth++;
+        }
+
+        //最外层的endUpdate()在状态有变化时通知一次
+        void endUpdate(){
+            if(updateDepth > 0 && --updateDepth == 0){
+                notify();
+            }
+        }
+};
+
+//并发主题：notify()读取一份不可变的观察者快照，attach/detach复制出新快照后原子地替换旧快照（copy-on-write）
+//读端无锁：notify()只在当前epoch对应的读者计数上做一次原子加减，然后直接读取原子指针指向的快照，不会阻塞；
+//写线程之间用writeMutex串行化，旧快照等到宽限期（替换前开始的notify()全部结束）之后才释放，state使用原子变量
+//detach()返回时，替换前开始的notify()都已结束，之后不会再调用该观察者；在update()中调用时不等待（见waitIdle()）
+class ConcurrentSubject : public Subject{
+    private:
+        struct Entry{
+            Observer* observer;
+            std::uint64_t id;
+            METRICS_ONLY(std::shared_ptr<metrics::LatencyHistogram> latency = nullptr;)
+        };
+
+        using Snapshot = std::vector<Entry>;
+
+        //两个读者计数分别对应epoch的奇偶，各占一个缓存行
+        struct alignas(64) ReaderCount{
+            std::atomic<std::size_t> count{0};
+        };
+
+        //不等待宽限期就替换的旧快照积累到这么多时，attach()等待一次宽限期并释放它们
+        static constexpr std::size_t RetireThreshold = 8;
+
+        //读端登记：在当前epoch对应的计数上加一后重新读一次epoch，期间被写端切换了就撤销重试
+        //登记成功之后读到的快照在析构（计数减一）之前不会被释放
+        class ReadScope{
+            private:
+                const ConcurrentSubject &subject;
+                std::size_t parity;
+
+            public:
+                explicit ReadScope(const ConcurrentSubject &subject) : subject(subject){
+                    for(;;){
+                        std::uint64_t epoch = subject.epoch.load();
+                        parity = static_cast<std::size_t>(epoch & 1);
+                        subject.readers[parity].count.fetch_add(1);
+                        if(subject.epoch.load() == epoch){
+                            break;
+                        }
+                        subject.readers[parity].count.fetch_sub(1);
+                    }
+                    notifyDepth++;
+                }
+
+                ~ReadScope(){
+                    notifyDepth--;
+                    subject.readers[parity].count.fetch_sub(1, std::memory_order_release);
+                }
+
+                ReadScope(const ReadScope&) = delete;
+                ReadScope& operator=(const ReadScope&) = delete;
+        };
+
+        std::atomic<int> state;
+        std::atomic<const Snapshot*> current;
+        mutable std::atomic<std::uint64_t> epoch;
+        mutable ReaderCount readers[2];
+        std::mutex writeMutex;
+        std::unique_ptr<const Snapshot> owned;//current指向的快照，以下成员都由writeMutex保护
+        std::vector<std::unique_ptr<const Snapshot>> retired;//已被替换、可能仍有读者的旧快照
+        std::uint64_t nextId;
+        METRICS_ONLY(metrics::SubjectMetrics stats{"ConcurrentSubject"};)
+
+        //当前线程正在执行的ConcurrentSubject::notify()层数；在update()中等待宽限期会等到自己，可能死锁
+        inline static thread_local int notifyDepth = 0;
+
+        //宽限期：切换epoch后等待旧epoch的读者全部离开，新的notify()登记在另一个计数上，不会拖长等待
+        //上一次宽限期已经等空了另一个计数，所以切换一次就够了；完成后释放所有旧快照
+        void waitForReaders(){
+            std::uint64_t old = epoch.load(std::memory_order_relaxed);
+            epoch.store(old + 1);
+            std::size_t parity = static_cast<std::size_t>(old & 1);
+            for(int spins = 0; readers[parity].count.load() != 0; spins++){
+                if(spins < 64){
+                    std::this_thread::yield();
+                }else{
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+            retired.clear();
+        }
+
+        //在writeMutex保护下复制当前快照、修改后发布；wait为true且不在update()中时等待宽限期
+        template<typename Modify>
+        void publish(Modify modify, bool wait){
+            auto next = std::make_unique<Snapshot>(*owned);
+            modify(*next);
+            current.store(next.get());
+            retired.push_back(std::move(owned));
+            owned = std::move(next);
+            if(notifyDepth == 0 && (wait || retired.size() >= RetireThreshold)){
+                waitForReaders();
+            }
+        }
+
+    protected:
+
+    public:
+        ConcurrentSubject() : state(0), epoch(0), owned(std::make_unique<const Snapshot>()), nextId(0){
+            current.store(owned.get());
+            LOG_DEBUG("ConcurrentSubject created");
+        }
+
+        //调用者保证析构时没有进行中的notify()
+        ~ConcurrentSubject(){
+            LOG_DEBUG("ConcurrentSubject destroyed");
+        }
+
+        //不等待进行中的notify()，新观察者从之后开始的通知起生效
+        Subscription attach(Observer* observer) override{
+            std::lock_guard<std::mutex> lock(writeMutex);
+            Entry entry{observer, nextId++};
+            METRICS_ONLY(entry.latency = stats.track(observer);)
+            publish([&entry](Snapshot &snapshot){
+                snapshot.push_back(entry);
+            }, false);
+            return subscriptionFromId(entry.id);
+        }
+
+        void detach(Observer* observer) override{
+            std::lock_guard<std::mutex> lock(writeMutex);
+            publish([observer](Snapshot &snapshot){
+                snapshot.erase(std::remove_if(snapshot.begin(), snapshot.end(),
+                    [observer](const Entry &entry) {
+                        return entry.observer == observer;
+                    }),
+                    snapshot.end());
+            }, true);
+        }
+
+        void detach(Subscription subscription) override{
+            std::uint64_t id = idFromSubscription(subscription);
+            std::lock_guard<std::mutex> lock(writeMutex);
+            publish([id](Snapshot &snapshot){
+                snapshot.erase(std::remove_if(snapshot.begin(), snapshot.end(),
+                    [id](const Entry &entry) {
+                        return entry.id == id;
+                    }),
+                    snapshot.end());
+            }, true);
+        }
+
+        //登记为读者直到遍历结束，update()中attach/detach只会影响之后的通知
+        void notify() override{
+            ReadScope scope(*this);
+            const Snapshot &snapshot = *current.load();
+            METRICS_ONLY(stats.countNotify();)
+            for(const Entry &entry : snapshot){
+                METRICS_ONLY(std::uint64_t start = metrics::nowNanos();)
+                entry.observer->update(this);
+                METRICS_ONLY(entry.latency->recordSince(start);)
+            }
+            METRICS_ONLY(stats.countDeliveries(snapshot.size());)
+        }
+
+        //等待调用前开始的notify()全部结束，之后可以安全销毁在update()中注销的观察者；在update()中调用时抛出std::logic_error
+        void waitIdle(){
+            if(notifyDepth > 0){
+                throw std::logic_error("ConcurrentSubject::waitIdle() called from update()");
+            }
+            std::lock_guard<std::mutex> lock(writeMutex);
+            waitForReaders();
+        }
+
+        METRICS_ONLY(const metrics::SubjectMetrics& statistics() const{ return stats; })
+
+        void setState(int state){
+            this->state.store(state, std::memory_order_release);
+        }
+
+        int getState() const override {
+            return state.load(std::memory_order_acquire);
+        }
+};
+
+//异步通知的背压策略：观察者的邮箱已满时如何处理新的状态
+enum class BackpressurePolicy{
+    Block,//生产者等待，直到邮箱出现空位
+    DropNewest,//丢弃新的状态
+    LatestWins//用新状态覆盖邮箱中最新的一条，落后的观察者只会看到最新状态
+};
+
+//异步主题：setState()只把状态放进每个观察者的有界环形邮箱，由线程池异步调用update()，慢观察者不会拖住生产者
+//每个邮箱同一时刻最多只有一个投递任务在运行，因此对同一个观察者的通知保持顺序
+//update()中调用getState()得到的是本次投递的状态，而不是主题此刻的最新状态
+class AsyncSubject : public Subject{
+    private:
+        struct Mailbox{
+            Observer* observer;
+            std::uint64_t id;
+            std::vector<int> ring;//固定容量的环形缓冲区
+            std::size_t head = 0;
+            std::size_t count = 0;
+            bool scheduled = false;//是否已有投递任务
+            bool closed = false;//已注销，不再接收和投递
+            METRICS_ONLY(std::shared_ptr<metrics::LatencyHistogram> latency = nullptr;)
+            std::mutex mutex;
+            std::condition_variable changed;
+        };
+
+        //当前线程正在投递的状态，供getState()返回
+        struct Delivery{
+            const AsyncSubject* subject;
+            const Mailbox* mailbox;
+            int state;
+        };
+
+        using Snapshot = std::vector<std::shared_ptr<Mailbox>>;
+
+        inline static thread_local const Delivery* currentDelivery = nullptr;
+
+        std::atomic<int> state;
+        SnapshotPtr<Snapshot> mailboxes;//写时复制的邮箱快照
+        std::mutex writeMutex;
+        Snapshot closing;//在投递线程上关闭、投递可能尚未结束的邮箱，由writeMutex保护
+        std::uint64_t nextId;
+        ThreadPool &executor;
+        BackpressurePolicy policy;
+        std::size_t capacity;
+        METRICS_ONLY(metrics::SubjectMetrics stats{"AsyncSubject"};)
+
+        void enqueue(const std::shared_ptr<Mailbox> &mailbox, int value){
+            std::unique_lock<std::mutex> lock(mailbox->mutex);
+            if(mailbox->count == capacity){
+                switch(policy){
+                    case BackpressurePolicy::Block:
+                        mailbox->changed.wait(lock, [this, &mailbox]{
+                            return mailbox->count < capacity || mailbox->closed;
+                        });
+                        break;
+                    case BackpressurePolicy::DropNewest:
+                        METRICS_ONLY(stats.countDropped();)
+                        return;
+                    case BackpressurePolicy::LatestWins:
+                        mailbox->ring[(mailbox->head + mailbox->count - 1) % capacity] = value;//合并到最新的一条
+                        METRICS_ONLY(stats.countCoalesced();)
+                        return;
+                }
+            }
+            if(mailbox->closed){
+                return;
+            }
+            mailbox->ring[(mailbox->head + mailbox->count) % capacity] = value;
+            mailbox->count++;
+            if(!mailbox->scheduled){
+                mailbox->scheduled = true;
+                lock.unlock();
+                executor.submit([this, mailbox]{ drain(mailbox); });
+            }
+        }
+
+        //在线程池中依次投递邮箱里的状态，直到邮箱为空
+        void drain(const std::shared_ptr<Mailbox> &mailbox){
+            std::unique_lock<std::mutex> lock(mailbox->mutex);
+            while(mailbox->count > 0 && !mailbox->closed){
+                Delivery delivery{this, mailbox.get(), mailbox->ring[mailbox->head]};
+                mailbox->head = (mailbox->head + 1) % capacity;
+                mailbox->count--;
+                mailbox->changed.notify_all();//唤醒因Block策略等待的生产者
+                lock.unlock();
+                const Delivery *previous = currentDelivery;
+                currentDelivery = &delivery;
+                METRICS_ONLY(std::uint64_t start = metrics::nowNanos();)
+                try{
+                    mailbox->observer->update(this);
+                }catch(const std::exception &e){
+                    LOG_ERROR("AsyncSubject observer threw: ", e.what());
+                }catch(...){
+                    LOG_ERROR("AsyncSubject observer threw an unknown exception");
+                }
+                METRICS_ONLY(mailbox->latency->recordSince(start);)
+                METRICS_ONLY(stats.countDeliveries();)
+                currentDelivery = previous;
+                lock.lock();
+            }
+            mailbox->scheduled = false;
+            mailbox->changed.notify_all();
+        }
+
+        //关闭邮箱，之后不会再开始新的投递，并等待进行中的投递结束
+        //在投递线程上（任何update()中）调用时不等待：目标邮箱的drain可能排在当前任务之后，线程池满时永远轮不到它；
+        //这时邮箱记入closing，由waitIdle()或析构函数在投递线程之外等待
+        void close(const std::shared_ptr<Mailbox> &mailbox){
+            std::unique_lock<std::mutex> lock(mailbox->mutex);
+            mailbox->closed = true;
+            mailbox->count = 0;
+            mailbox->changed.notify_all();
+            if(currentDelivery == nullptr){
+                mailbox->changed.wait(lock, [&mailbox]{ return !mailbox->scheduled; });
+            }else if(mailbox->scheduled && currentDelivery->mailbox != mailbox.get()){
+                lock.unlock();
+                std::lock_guard<std::mutex> guard(writeMutex);
+                closing.push_back(mailbox);
+            }
+        }
+
+        //等待在投递线程上关闭的邮箱结束投递
+        void waitClosed(){
+            Snapshot pending;
+            {
+                std::lock_guard<std::mutex> lock(writeMutex);
+                pending.swap(closing);
+            }
+            for(const auto &mailbox : pending){
+                std::unique_lock<std::mutex> lock(mailbox->mutex);
+                mailbox->changed.wait(lock, [&mailbox]{ return !mailbox->scheduled; });
+            }
+        }
+
+        //在writeMutex保护下从快照中摘除满足pred的邮箱，返回被摘除的邮箱
+        template<typename Pred>
+        Snapshot remove(Pred pred){
+            std::lock_guard<std::mutex> lock(writeMutex);
+            auto next = std::make_shared<Snapshot>();
+            Snapshot removed;
+            for(const auto &mailbox : *mailboxes.load()){
+                (pred(*mailbox) ? removed : *next).push_back(mailbox);
+            }
+            mailboxes.store(std::move(next));
+            return removed;
+        }
+
+    protected:
+
+    public:
+        //capacity是每个观察者邮箱的容量，至少为1
+        explicit AsyncSubject(BackpressurePolicy policy = BackpressurePolicy::LatestWins, std::size_t capacity = 1, ThreadPool &executor = ThreadPool::shared())
+            : state(0), mailboxes(std::make_shared<const Snapshot>()), nextId(0), executor(executor), policy(policy), capacity(std::max<std::size_t>(capacity, 1)){
+            LOG_DEBUG("AsyncSubject created");
+        }
+
+        //关闭全部邮箱，等待进行中的投递结束
+        ~AsyncSubject(){
+            for(const auto &mailbox : remove([](const Mailbox &){ return true; })){
+                close(mailbox);
+            }
+            waitClosed();
+            LOG_DEBUG("AsyncSubject destroyed");
+        }
+
+        Subscription attach(Observer* observer) override{
+            auto mailbox = std::make_shared<Mailbox>();
+            mailbox->observer = observer;
+            mailbox->ring.resize(capacity);
+            METRICS_ONLY(mailbox->latency = stats.track(observer);)
+            std::lock_guard<std::mutex> lock(writeMutex);
+            mailbox->id = nextId++;
+            auto next = std::make_shared<Snapshot>(*mailboxes.load());
+            next->push_back(mailbox);
+            mailboxes.store(std::move(next));
+            return subscriptionFromId(mailbox->id);
+        }
+
+        //返回后不会再有对该观察者的投递；在update()中调用时，另一个线程上正在进行的一次投递可能尚未结束，
+        //需要销毁观察者时先在投递线程之外调用waitIdle()
+        void detach(Observer* observer) override{
+            for(const auto &mailbox : remove([observer](const Mailbox &mailbox){ return mailbox.observer == observer; })){
+                close(mailbox);
+            }
+        }
+
+        void detach(Subscription subscription) override{
+            std::uint64_t id = idFromSubscription(subscription);
+            for(const auto &mailbox : remove([id](const Mailbox &mailbox){ return mailbox.id == id; })){
+                close(mailbox);
+            }
+        }
+
+        //把当前状态再投递给所有观察者
+        void notify() override{
+            int value = state.load(std::memory_order_acquire);
+            std::shared_ptr<const Snapshot> snapshot = mailboxes.load();
+            METRICS_ONLY(stats.countNotify();)
+            for(const auto &mailbox : *snapshot){
+                enqueue(mailbox, value);
+            }
+        }
+
+        //更新状态并投递给所有观察者，不等待update()执行
+        void setState(int state){
+            this->state.store(state, std::memory_order_release);
+            notify();
+        }
+
+        int getState() const override {
+            if(currentDelivery != nullptr && currentDelivery->subject == this){
+                return currentDelivery->state;
+            }
+            return state.load(std::memory_order_acquire);
+        }
+
+        METRICS_ONLY(const metrics::SubjectMetrics& statistics() const{ return stats; })
+
+        //等待所有邮箱清空、投递任务全部结束，包括在update()中被注销的观察者；不能在update()中调用
+        void waitIdle(){
+            std::shared_ptr<const Snapshot> snapshot = mailboxes.load();
+            for(const auto &mailbox : *snapshot){
+                std::unique_lock<std::mutex> lock(mailbox->mutex);
+                mailbox->changed.wait(lock, [&mailbox]{ return mailbox->count == 0 && !mailbox->scheduled; });
+            }
+            waitClosed();
+        }
+};
+
+//事件总线：集中保存多个主题的订阅，并在分片的工作线程上异步投递
+//每个主题按地址哈希到一个分片，每个分片一个工作线程和一个FIFO队列，因此同一主题的事件按发布顺序投递；
+//分片按主题保存订阅列表，增删只触及该主题的列表，均摊O(1)，不复制任何表
+//订阅列表只由所属分片的工作线程在投递时读取：工作线程空闲时修改直接生效，投递期间的修改先排队，由工作线程在两个事件之间应用
+class EventBus{
+    private:
+        struct Subscriber{
+            Observer* observer;
+            std::uint32_t id;
+            bool live;
+            METRICS_ONLY(std::shared_ptr<metrics::LatencyHistogram> latency = nullptr;)
+        };
+
+        //一个主题的订阅，按注册顺序排列；注销只做标记，死元素超过一半时整体压缩，保持顺序
+        struct SubscriberList{
+            std::vector<Subscriber> entries;
+            std::size_t dead = 0;
+        };
+
+        //订阅编号对应的主题和在entries中的下标，按句柄注销时不需要扫描
+        struct Location{
+            const Subject* subject;
+            std::size_t index;
+        };
+
+        struct Change{
+            enum class Kind{ Add, RemoveId, RemoveObserver };
+
+            Kind kind;
+            const Subject* subject;
+            Subscriber subscriber;//Add
+            std::uint32_t id;//RemoveId
+            Observer* observer;//RemoveObserver，为nullptr时删除该主题的全部订阅
+        };
+
+        struct Event{
+            Subject* subject;
+            int state;
+        };
+
+        struct Shard{
+            std::mutex mutex;
+            std::condition_variable wakeup;
+            std::condition_variable progress;//投递批次推进、排队的修改被应用时通知
+            std::vector<Event> queue;//等待投递的事件，工作线程整批交换出去
+            std::unordered_map<const Subject*, SubscriberList> lists;
+            std::unordered_map<std::uint32_t, Location> locations;
+            std::vector<Change> changes;//投递期间到达的修改
+            std::atomic<bool> changed{false};//changes非空，工作线程每个事件前检查一次
+            std::uint64_t requested = 0;//已提交的修改数
+            std::uint64_t applied = 0;//已生效的修改数
+            std::uint64_t published = 0;//已入队的事件数
+            std::uint64_t processed = 0;//已投递完的事件数
+            std::uint32_t nextId = 0;
+            bool processing = false;//为true时只有工作线程可以访问lists和locations
+            bool stopping = false;
+            std::thread worker;
+        };
+
+        //当前线程正在投递的事件，供BusSubject::getState()返回
+        struct Delivery{
+            const Shard* shard;
+            const Subject* subject;
+            int state;
+        };
+
+        inline static thread_local const Delivery* currentDelivery = nullptr;
+
+        std::vector<std::unique_ptr<Shard>> shards;
+        METRICS_ONLY(metrics::SubjectMetrics stats{"EventBus"};)
+
+        //斐波那契哈希：对齐的地址低位都是0，直接取模会集中到少数分片
+        std::size_t shardIndex(const Subject* subject) const{
+            std::uint64_t key = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(subject));
+            return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) % shards.size();
+        }
+
+        static void markDead(Shard &shard, SubscriberList &list, Subscriber &subscriber){
+            subscriber.live = false;
+            METRICS_ONLY(subscriber.latency.reset();)
+            shard.locations.erase(subscriber.id);
+            list.dead++;
+        }
+
+        //死元素超过一半时压缩并更新下标；全部注销后删除该主题的列表
+        static void compact(Shard &shard, const Subject* subject, SubscriberList &list){
+            if(list.dead * 2 <= list.entries.size()){
+                return;
+            }
+            if(list.dead == list.entries.size()){
+                shard.lists.erase(subject);
+                return;
+            }
+            std::size_t count = 0;
+            for(Subscriber &subscriber : list.entries){
+                if(subscriber.live){
+                    shard.locations[subscriber.id].index = count;
+                    list.entries[count++] = std::move(subscriber);
+                }
+            }
+            list.entries.resize(count);
+            list.dead = 0;
+        }
+
+        //在shard.mutex保护下、工作线程不在投递时调用
+        static void apply(Shard &shard, Change &change){
+            switch(change.kind){
+                case Change::Kind::Add:{
+                    SubscriberList &list = shard.lists[change.subject];
+                    shard.locations[change.subscriber.id] = Location{change.subject, list.entries.size()};
+                    list.entries.push_back(std::move(change.subscriber));
+                    break;
+                }
+                case Change::Kind::RemoveId:{
+                    auto location = shard.locations.find(change.id);
+                    if(location == shard.locations.end()){
+                        break;
+                    }
+                    const Subject* subject = location->second.subject;
+                    SubscriberList &list = shard.lists.find(subject)->second;
+                    markDead(shard, list, list.entries[location->second.index]);
+                    compact(shard, subject, list);
+                    break;
+                }
+                case Change::Kind::RemoveObserver:{
+                    auto found = shard.lists.find(change.subject);
+                    if(found == shard.lists.end()){
+                        break;
+                    }
+                    SubscriberList &list = found->second;
+                    for(Subscriber &subscriber : list.entries){
+                        if(subscriber.live && (change.observer == nullptr || subscriber.observer == change.observer)){
+                            markDead(shard, list, subscriber);
+                        }
+                    }
+                    compact(shard, change.subject, list);
+                    break;
+                }
+            }
+        }
+
+        void applyChanges(Shard &shard){
+            for(Change &change : shard.changes){
+                apply(shard, change);
+            }
+            shard.applied += shard.changes.size();
+            shard.changes.clear();
+            shard.changed.store(false, std::memory_order_relaxed);
+            shard.progress.notify_all();
+        }
+
+        //在shard.mutex保护下提交修改：工作线程空闲时立即生效，否则排队；返回修改的序号
+        std::uint64_t submit(Shard &shard, Change change){
+            std::uint64_t ticket = ++shard.requested;
+            if(!shard.processing){
+                apply(shard, change);
+                shard.applied = ticket;
+            }else{
+                shard.changes.push_back(std::move(change));
+                shard.changed.store(true, std::memory_order_release);
+            }
+            return ticket;
+        }
+
+        //等待排队的修改生效；在投递线程中调用时不等待，否则两个分片的update()互相注销时会死锁
+        void waitApplied(Shard &shard, std::unique_lock<std::mutex> &lock, std::uint64_t ticket){
+            if(currentDelivery != nullptr){
+                return;
+            }
+            shard.progress.wait(lock, [&shard, ticket]{ return shard.applied >= ticket; });
+        }
+
+        void run(Shard &shard){
+            std::vector<Event> batch;
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            for(;;){
+                shard.wakeup.wait(lock, [&shard]{ return shard.stopping || !shard.queue.empty(); });
+                if(shard.queue.empty()){
+                    return;//stopping，并且剩余事件已经全部投递
+                }
+                batch.swap(shard.queue);
+                shard.processing = true;
+                lock.unlock();
+                for(const Event &event : batch){
+                    //有排队的修改时才加锁应用，前一个事件的update()中注销的观察者不会再收到后续事件
+                    if(shard.changed.load(std::memory_order_acquire)){
+                        lock.lock();
+                        applyChanges(shard);
+                        lock.unlock();
+                    }
+                    deliver(shard, event);
+                }
+                lock.lock();
+                applyChanges(shard);
+                shard.processed += batch.size();
+                shard.processing = false;
+                shard.progress.notify_all();
+                batch.clear();
+            }
+        }
+
+        void deliver(const Shard &shard, const Event &event){
+            auto found = shard.lists.find(event.subject);
+            if(found == shard.lists.end()){
+                return;
+            }
+            Delivery delivery{&shard, event.subject, event.state};
+            const Delivery *previous = currentDelivery;
+            currentDelivery = &delivery;
+            //投递期间的修改都在排队，entries不会变化
+            const std::vector<Subscriber> &entries = found->second.entries;
+            METRICS_ONLY(std::size_t delivered = 0;)
+            for(const Subscriber &subscriber : entries){
+                if(!subscriber.live){
+                    continue;
+                }
+                METRICS_ONLY(std::uint64_t start = metrics::nowNanos();)
+                try{
+                    subscriber.observer->update(event.subject);
+                }catch(const std::exception &e){
+                    LOG_ERROR("EventBus observer threw: ", e.what());
+                }catch(...){
+                    LOG_ERROR("EventBus observer threw an unknown exception");
+                }
+                METRICS_ONLY(subscriber.latency->recordSince(start);)
+                METRICS_ONLY(delivered++;)
+            }
+            METRICS_ONLY(stats.countDeliveries(delivered);)
+            currentDelivery = previous;
+        }
+
+    protected:
+
+    public:
+        //默认每个硬件线程一个分片
+        explicit EventBus(std::size_t shardCount = std::max(1u, std::thread::hardware_concurrency())){
+            shardCount = std::max<std::size_t>(shardCount, 1);
+            for(std::size_t i = 0; i < shardCount; i++){
+                shards.push_back(std::make_unique<Shard>());
+            }
+            for(auto &shard : shards){
+                Shard *target = shard.get();
+                shard->worker = std::thread([this, target]{ run(*target); });
+            }
+            LOG_DEBUG("EventBus created");
+        }
+
+        //投递完已发布的事件后结束工作线程
+        ~EventBus(){
+            for(auto &shard : shards){
+                {
+                    std::lock_guard<std::mutex> lock(shard->mutex);
+                    shard->stopping = true;
+                }
+                shard->wakeup.notify_one();
+            }
+            for(auto &shard : shards){
+                shard->worker.join();
+            }
+            LOG_DEBUG("EventBus destroyed");
+        }
+
+        EventBus(const EventBus&) = delete;
+        EventBus& operator=(const EventBus&) = delete;
+
+        std::size_t shardCount() const{
+            return shards.size();
+        }
+
+        //同一主题的订阅按注册顺序投递，之后发布的事件都会送达；返回的句柄中slot是分片下标
+        Subscription subscribe(Subject* subject, Observer* observer){
+            std::size_t index = shardIndex(subject);
+            Shard &shard = *shards[index];
+            Change change{Change::Kind::Add, subject, Subscriber{observer, 0, true}, 0, nullptr};
+            METRICS_ONLY(change.subscriber.latency = stats.track(observer);)
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            std::uint32_t id = shard.nextId++;
+            change.subscriber.id = id;
+            submit(shard, std::move(change));
+            return Subscription{static_cast<std::uint32_t>(index), id};
+        }
+
+        //返回后该观察者不会再收到这个订阅的事件（在投递线程中注销的情况除外，见waitApplied()）
+        void unsubscribe(Subscription subscription){
+            if(subscription.slot >= shards.size()){
+                return;
+            }
+            Shard &shard = *shards[subscription.slot];
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            std::uint64_t ticket = submit(shard, Change{Change::Kind::RemoveId, nullptr, Subscriber{}, subscription.generation, nullptr});
+            waitApplied(shard, lock, ticket);
+        }
+
+        //observer为nullptr时注销该主题的全部订阅
+        void unsubscribe(Subject* subject, Observer* observer){
+            Shard &shard = *shards[shardIndex(subject)];
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            std::uint64_t ticket = submit(shard, Change{Change::Kind::RemoveObserver, subject, Subscriber{}, 0, observer});
+            waitApplied(shard, lock, ticket);
+        }
+
+        //注销主题的全部订阅，并等待它已发布的事件处理完，之后主题可以安全销毁
+        void retire(Subject* subject){
+            unsubscribe(subject, nullptr);
+            Shard &shard = *shards[shardIndex(subject)];
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            if(currentDelivery != nullptr && currentDelivery->shard == &shard){
+                return;
+            }
+            std::uint64_t target = shard.published;
+            shard.progress.wait(lock, [&shard, target]{ return shard.processed >= target; });
+        }
+
+        //把事件放进主题所属分片的队列，不等待投递；update(subject)在工作线程中调用
+        void publish(Subject* subject, int state){
+            Shard &shard = *shards[shardIndex(subject)];
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.queue.push_back(Event{subject, state});
+                shard.published++;
+            }
+            shard.wakeup.notify_one();
+            METRICS_ONLY(stats.countNotify();)
+        }
+
+        //等待所有分片队列清空、投递结束；不能在投递线程中调用
+        void waitIdle(){
+            for(auto &shard : shards){
+                std::unique_lock<std::mutex> lock(shard->mutex);
+                std::uint64_t target = shard->published;
+                shard->progress.wait(lock, [&shard, target]{ return shard->processed >= target; });
+            }
+        }
+
+        //正在投递subject的事件时返回true，并把事件携带的状态写入state
+        static bool deliveredState(const Subject* subject, int &state){
+            if(currentDelivery == nullptr || currentDelivery->subject != subject){
+                return false;
+            }
+            state = currentDelivery->state;
+            return true;
+        }
+
+        METRICS_ONLY(const metrics::SubjectMetrics& statistics() const{ return stats; })
+};
+
+//接入事件总线的主题：订阅保存在总线中，notify()把当前状态发布到总线，由分片线程异步调用update()
+//update()中调用getState()得到的是本次投递的状态；同一主题的通知按notify()的顺序到达
+//其他Subject子类也可以直接用EventBus::subscribe()/publish()接入，此时update()中读取的是主题的实时状态
+class BusSubject : public Subject{
+    private:
+        EventBus &bus;
+        std::atomic<int> state;
+
+    protected:
+
+    public:
+        explicit BusSubject(EventBus &bus) : bus(bus), state(0){
+            LOG_DEBUG("BusSubject created");
+        }
+
+        //注销全部订阅并等待已发布的事件投递完
+        ~BusSubject(){
+            bus.retire(this);
+            LOG_DEBUG("BusSubject destroyed");
+        }
+
+        Subscription attach(Observer* observer) override{
+            return bus.subscribe(this, observer);
+        }
+
+        void detach(Observer* observer) override{
+            if(observer != nullptr){
+                bus.unsubscribe(this, observer);
+            }
+        }
+
+        void detach(Subscription subscription) override{
+            bus.unsubscribe(subscription);
+        }
+
+        void notify() override{
+            bus.publish(this, state.load(std::memory_order_acquire));
+        }
+
+        void setState(int state){
+            this->state.store(state, std::memory_order_release);
+        }
+
+        int getState() const override {
+            int delivered;
+            if(EventBus::deliveredState(this, delivered)){
+                return delivered;
+            }
+            return state.load(std::memory_order_acquire);
+        }
+};
+
+//推模型：主题把事件负载按const引用直接交给观察者，观察者不需要再dynamic_cast回具体主题、也不需要再调用getState()
+//每次投递只有一次虚调用
+template<typename Event>
+class EventObserver{
+    private:
+
+    protected:
+
+    public:
+        virtual ~EventObserver() = default;
+        virtual void update(const Event& event) = 0;
+};
+
+template<typename Event>
+class EventSubject{
+    private:
+        SubscriptionList<EventObserver<Event>*> observers;
+
+    protected:
+
+    public:
+        Subscription attach(EventObserver<Event>* observer){
+            return observers.add(observer);
+        }
+
+        void detach(EventObserver<Event>* observer){
+            observers.removeIf([observer](EventObserver<Event>* ptr) {
+                return ptr == observer;
+            });
+        }
+
+        void detach(Subscription subscription){
+            observers.remove(subscription);
+        }
+
+        //与ConcreteSubject一样，update()中attach/detach是安全的
+        void notify(const Event& event){
+            observers.forEach([&event](EventObserver<Event>* observer){
+                observer->update(event);
+            });
+        }
+};
+
+//按主题和谓词过滤、按优先级排序的推模型主题
+//每个主题一个桶，桶内按优先级从高到低排好序；notify(topic, event)只访问该主题的桶、通配订阅和谓词订阅，
+//三者按优先级归并后依次投递，其他主题的订阅者完全不会被触及。优先级相同时先订阅的先收到
+template<typename Event, typename Key = int>
+class TopicSubject{
+    private:
+        struct Entry{
+            EventObserver<Event>* observer;
+            int priority;
+            std::uint64_t id;
+            bool active;//通知过程中被注销的订阅先置为false，通知结束后再删除
+        };
+
+        //订阅所在位置，注销时用来找到对应的桶
+        enum class Kind{
+            Topic,
+            All,
+            Predicate
+        };
+
+        struct Location{
+            Kind kind;
+            Key topic;
+        };
+
+        std::unordered_map<Key, std::vector<Entry>> topics;
+        std::vector<Entry> wildcards;
+        std::vector<Entry> predicates;
+        std::vector<std::function<bool(const Event&)>> filters;//与predicates一一对应
+        std::unordered_map<std::uint64_t, Location> locations;
+        std::uint64_t nextId;
+        int notifying;//notify()嵌套深度
+        std::vector<std::function<void()>> deferred;//通知过程中推迟执行的增删
+
+        static bool before(const Entry& left, const Entry& right){
+            return left.priority > right.priority || (left.priority == right.priority && left.id < right.id);
+        }
+
+        //插入到同优先级的最后，保持桶有序；返回插入位置
+        static std::size_t insertSorted(std::vector<Entry>& bucket, const Entry& entry){
+            auto position = std::upper_bound(bucket.begin(), bucket.end(), entry, before);
+            std::size_t index = position - bucket.begin();
+            bucket.insert(position, entry);
+            return index;
+        }
+
+        static std::size_t find(const std::vector<Entry>& bucket, std::uint64_t id){
+            for(std::size_t i = 0; i < bucket.size(); i++){
+                if(bucket[i].id == id){
+                    return i;
+                }
+            }
+            return bucket.size();
+        }
+
+        //在通知过程中推迟执行，否则立即执行
+        template<typename Func>
+        void modify(Func func){
+            if(notifying > 0){
+                deferred.emplace_back(std::move(func));
+            }else{
+                func();
+            }
+        }
+
+        Entry* lookup(std::uint64_t id){
+            auto location = locations.find(id);
+            if(location == locations.end()){
+                return nullptr;
+            }
+            std::vector<Entry>* bucket = &wildcards;
+            if(location->second.kind == Kind::Topic){
+                auto topic = topics.find(location->second.topic);
+                if(topic == topics.end()){
+                    return nullptr;//新增还在推迟中，桶尚未创建
+                }
+                bucket = &topic->second;
+            }else if(location->second.kind == Kind::Predicate){
+                bucket = &predicates;
+            }
+            std::size_t index = find(*bucket, id);
+            return index < bucket->size() ? &(*bucket)[index] : nullptr;
+        }
+
+        //订阅不在任何桶中时（例如新增尚未执行）只删除位置记录
+        void erase(std::uint64_t id){
+            auto location = locations.find(id);
+            if(location == locations.end()){
+                return;
+            }
+            if(location->second.kind == Kind::Topic){
+                auto bucket = topics.find(location->second.topic);
+                if(bucket != topics.end()){
+                    std::size_t index = find(bucket->second, id);
+                    if(index < bucket->second.size()){
+                        bucket->second.erase(bucket->second.begin() + index);
+                    }
+                    if(bucket->second.empty()){
+                        topics.erase(bucket);
+                    }
+                }
+            }else if(location->second.kind == Kind::All){
+                std::size_t index = find(wildcards, id);
+                if(index < wildcards.size()){
+                    wildcards.erase(wildcards.begin() + index);
+                }
+            }else{
+                std::size_t index = find(predicates, id);
+                if(index < predicates.size()){
+                    predicates.erase(predicates.begin() + index);
+                    filters.erase(filters.begin() + index);
+                }
+            }
+            locations.erase(location);
+        }
+
+        //和SubscriptionList::IterationScope一样：update()抛出异常时也要恢复嵌套深度，并在最外层执行推迟的增删
+        struct NotifyScope{
+            TopicSubject &subject;
+
+            explicit NotifyScope(TopicSubject &subject) : subject(subject){
+                subject.notifying++;
+            }
+
+            ~NotifyScope(){
+                if(--subject.notifying == 0){
+                    while(!subject.deferred.empty()){
+                        std::vector<std::function<void()>> pending;
+                        pending.swap(subject.deferred);
+                        for(auto& func : pending){
+                            func();
+                        }
+                    }
+                }
+            }
+        };
+
+        Subscription add(Kind kind, const Key& topic, EventObserver<Event>* observer, int priority, std::function<bool(const Event&)> filter){
+            std::uint64_t id = nextId++;
+            locations.emplace(id, Location{kind, topic});
+            modify([this, kind, topic, observer, priority, id, filter = std::move(filter)]() mutable{
+                Entry entry{observer, priority, id, true};
+                if(kind == Kind::Topic){
+                    insertSorted(topics[topic], entry);
+                }else if(kind == Kind::All){
+                    insertSorted(wildcards, entry);
+                }else{
+                    std::size_t index = insertSorted(predicates, entry);
+                    filters.insert(filters.begin() + index, std::move(filter));
+                }
+            });
+            return subscriptionFromId(id);
+        }
+
+    protected:
+
+    public:
+        TopicSubject() : nextId(0), notifying(0){}
+
+        //只接收topic主题的事件
+        Subscription attach(EventObserver<Event>* observer, const Key& topic, int priority = 0){
+            return add(Kind::Topic, topic, observer, priority, nullptr);
+        }
+
+        //接收所有主题的事件
+        Subscription attachAll(EventObserver<Event>* observer, int priority = 0){
+            return add(Kind::All, Key(), observer, priority, nullptr);
+        }
+
+        //接收满足filter的事件（例如状态落在某个区间内），filter只对谓词订阅者求值
+        Subscription attachIf(EventObserver<Event>* observer, std::function<bool(const Event&)> filter, int priority = 0){
+            return add(Kind::Predicate, Key(), observer, priority, std::move(filter));
+        }
+
+        //通知过程中注销时，本轮剩余的投递也会跳过该订阅
+        void detach(Subscription subscription){
+            std::uint64_t id = idFromSubscription(subscription);
+            if(notifying > 0){
+                if(Entry* entry = lookup(id)){
+                    entry->active = false;
+                }
+            }
+            modify([this, id]{ erase(id); });
+        }
+
+        void notify(const Key& topic, const Event& event){
+            NotifyScope scope(*this);
+            static const std::vector<Entry> none;
+            auto bucket = topics.find(topic);
+            const std::vector<Entry>& matched = bucket == topics.end() ? none : bucket->second;
+            //三路归并：每次从三个有序序列的队首中取优先级最高的一个
+            std::size_t i = 0, j = 0, k = 0;
+            for(;;){
+                const Entry* next = nullptr;
+                int source = -1;
+                if(i < matched.size()){
+                    next = &matched[i];
+                    source = 0;
+                }
+                if(j < wildcards.size() && (next == nullptr || before(wildcards[j], *next))){
+                    next = &wildcards[j];
+                    source = 1;
+                }
+                if(k < predicates.size() && (next == nullptr || before(predicates[k], *next))){
+                    next = &predicates[k];
+                    source = 2;
+                }
+                if(next == nullptr){
+                    break;
+                }
+                bool deliver = next->active;
+                if(source == 0){
+                    i++;
+                }else if(source == 1){
+                    j++;
+                }else{
+                    deliver = deliver && filters[k](event);
+                    k++;
+                }
+                if(deliver){
+                    next->observer->update(event);
+                }
+            }
+        }
+};
+
+//观察者列表在编译期确定的主题：Handlers是具体类型（不必继承EventObserver），notify()直接调用各自的update()，
+//没有间接调用，编译器可以全部内联
+template<typename Event, typename... Handlers>
+class StaticEventSubject{
+    private:
+        std::tuple<Handlers&...> handlers;
+
+    protected:
+
+    public:
+        explicit StaticEventSubject(Handlers&... handlers) : handlers(handlers...){}
+
+        void notify(const Event& event){
+            std::apply([&event](Handlers&... handler){ (handler.update(event), ...); }, handlers);
+        }
+};
+
+//事件类型需要显式给出，观察者类型由参数推导
+template<typename Event, typename... Handlers>
+StaticEventSubject<Event, Handlers...> makeStaticEventSubject(Handlers&... handlers){
+    return StaticEventSubject<Event, Handlers...>(handlers...);
+}
+
+class ConcreteObserver : public Observer{
+    private:
+        int state;
+
+    protected:
+
+    public:
+        ConcreteObserver(){
+            LOG_DEBUG("ConcreteObserver created");
+        }
+
+        ~ConcreteObserver(){
+            LOG_DEBUG("ConcreteObserver destroyed");
+        }
+
+        //getState()是Subject的虚函数，不需要dynamic_cast回具体主题；AsyncSubject、BusSubject在投递期间返回本次投递的状态
+        void update(Subject* subject) override{
+            this->state = subject->getState();
+            LOG_DEBUG("ConcreteObserver updated: ", this->state);
+        }
+
+
+};
+
+#endif
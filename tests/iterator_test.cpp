@@ -0,0 +1,386 @@
+#define ITERATOR_CHECKED 1//越界检查在发布构建中也开启，测试next()越界时的行为
+#include "../iterator/iterator.h"
+#include "test.h"
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+//迭代器模块的测试：向量化归约的尾部与余数处理、惰性流水线的越界约定、
+//可拆分迭代器与并行遍历、结构体数组集合的列视图
+namespace{
+
+//逐个比较的朴素实现，作为归约内核的参照
+template<typename T>
+T naiveSum(const T *data, std::size_t count){
+    T result = T();
+    for(std::size_t i = 0; i < count; i++){
+        result += data[i];
+    }
+    return result;
+}
+
+template<typename T>
+T naiveDot(const T *left, const T *right, std::size_t count){
+    T result = T();
+    for(std::size_t i = 0; i < count; i++){
+        result += left[i] * right[i];
+    }
+    return result;
+}
+
+template<typename T>
+T naiveMin(const T *data, std::size_t count){
+    T result = data[0];
+    for(std::size_t i = 1; i < count; i++){
+        result = std::min(result, data[i]);
+    }
+    return result;
+}
+
+template<typename T>
+T naiveMax(const T *data, std::size_t count){
+    T result = data[0];
+    for(std::size_t i = 1; i < count; i++){
+        result = std::max(result, data[i]);
+    }
+    return result;
+}
+
+//长度覆盖向量宽度的各个余数，起点偏移覆盖非对齐加载；最小和最大值分别放在末尾，只有尾部循环能看到
+//double取整数值，任何加法顺序都得到精确结果
+template<typename T, typename Kernels>
+void checkKernels(Kernels kernels){
+    constexpr std::size_t MaxCount = 67;
+    constexpr std::size_t MaxOffset = 3;
+    std::vector<T> left(MaxCount + MaxOffset);
+    std::vector<T> right(MaxCount + MaxOffset);
+    for(std::size_t offset = 0; offset <= MaxOffset; offset++){
+        for(std::size_t count = 0; count <= MaxCount; count++){
+            for(std::size_t i = 0; i < left.size(); i++){
+                left[i] = static_cast<T>(static_cast<int>(i * 7 % 23) - 11);
+                right[i] = static_cast<T>(static_cast<int>(i * 5 % 17) - 8);
+            }
+            const T *a = left.data() + offset;
+            const T *b = right.data() + offset;
+            CHECK(kernels.sum(a, count) == naiveSum(a, count));
+            CHECK(kernels.dot(a, b, count) == naiveDot(a, b, count));
+            if(count == 0){
+                continue;
+            }
+            left[offset + count - 1] = static_cast<T>(-1000);
+            CHECK(kernels.min(a, count) == static_cast<T>(-1000));
+            left[offset + count - 1] = static_cast<T>(1000);
+            CHECK(kernels.max(a, count) == static_cast<T>(1000));
+            left[offset + count - 1] = static_cast<T>(0);
+            CHECK(kernels.min(a, count) == naiveMin(a, count));
+            CHECK(kernels.max(a, count) == naiveMax(a, count));
+        }
+    }
+}
+
+//通过重载分派选择的内核（有AVX2时是AVX2，AArch64上是NEON）
+template<typename T>
+struct DispatchKernels{
+    T sum(const T *data, std::size_t count) const{ return reduction::sum(data, count); }
+    T dot(const T *left, const T *right, std::size_t count) const{ return reduction::dot(left, right, count); }
+    T min(const T *data, std::size_t count) const{ return reduction::min(data, count); }
+    T max(const T *data, std::size_t count) const{ return reduction::max(data, count); }
+};
+
+template<typename T>
+struct ScalarKernels{
+    T sum(const T *data, std::size_t count) const{ return reduction::sumScalar(data, count); }
+    T dot(const T *left, const T *right, std::size_t count) const{ return reduction::dotScalar(left, right, count); }
+    T min(const T *data, std::size_t count) const{ return reduction::minScalar(data, count); }
+    T max(const T *data, std::size_t count) const{ return reduction::maxScalar(data, count); }
+};
+
+#if REDUCTION_HAVE_AVX2
+template<typename T>
+struct Avx2Kernels{
+    T sum(const T *data, std::size_t count) const{ return reduction::sumAvx2(data, count); }
+    T dot(const T *left, const T *right, std::size_t count) const{ return reduction::dotAvx2(left, right, count); }
+    T min(const T *data, std::size_t count) const{ return reduction::minAvx2(data, count); }
+    T max(const T *data, std::size_t count) const{ return reduction::maxAvx2(data, count); }
+};
+#endif
+
+#if REDUCTION_HAVE_NEON
+template<typename T>
+struct NeonKernels{
+    T sum(const T *data, std::size_t count) const{ return reduction::sumNeon(data, count); }
+    T dot(const T *left, const T *right, std::size_t count) const{ return reduction::dotNeon(left, right, count); }
+    T min(const T *data, std::size_t count) const{ return reduction::minNeon(data, count); }
+    T max(const T *data, std::size_t count) const{ return reduction::maxNeon(data, count); }
+};
+#endif
+
+void testReductionKernels(){
+    checkKernels<int>(ScalarKernels<int>());
+    checkKernels<double>(ScalarKernels<double>());
+    checkKernels<long>(DispatchKernels<long>());//没有向量化重载的类型走标量模板
+    checkKernels<int>(DispatchKernels<int>());
+    checkKernels<double>(DispatchKernels<double>());
+#if REDUCTION_HAVE_AVX2
+    //CPU不支持AVX2时分派已经覆盖了标量版本，AVX2内核本身不能运行
+    if(reduction::hasAvx2()){
+        checkKernels<int>(Avx2Kernels<int>());
+        checkKernels<double>(Avx2Kernels<double>());
+    }
+#endif
+#if REDUCTION_HAVE_NEON
+    checkKernels<int>(NeonKernels<int>());
+    checkKernels<double>(NeonKernels<double>());
+#endif
+}
+
+//CustomCollection的归约：空集合的min()/max()抛出异常，dot()要求长度相同
+void testCollectionReductions(){
+    CustomCollection<int> collection;
+    CHECK(collection.sum() == 0);
+    bool threw = false;
+    try{
+        collection.min();
+    }catch(const std::out_of_range &){
+        threw = true;
+    }
+    CHECK(threw);
+    for(int i = 1; i <= 19; i++){
+        collection.add(i % 2 == 0 ? i : -i);
+    }
+    CHECK(collection.sum() == -10);
+    CHECK(collection.min() == -19);
+    CHECK(collection.max() == 18);
+    CHECK(collection.dot(collection) == 2470);
+    CHECK(collection.countIf([](int item){ return item > 0; }) == 9);
+
+    CustomCollection<int> shorter;
+    shorter.add(1);
+    threw = false;
+    try{
+        collection.dot(shorter);
+    }catch(const std::invalid_argument &){
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+//取空流水线后：hasNext()可以重复调用并一直返回false，next()抛出std::out_of_range
+template<typename P>
+bool exhaustedAndThrows(P pipeline){
+    while(pipeline.hasNext()){
+        pipeline.next();
+    }
+    if(pipeline.hasNext() || pipeline.hasNext()){
+        return false;
+    }
+    try{
+        pipeline.next();
+    }catch(const std::out_of_range &){
+        return true;
+    }
+    return false;
+}
+
+//把流水线的全部元素收集到vector中
+template<typename P>
+std::vector<int> collect(P pipeline){
+    std::vector<int> result;
+    pipeline.forEach([&result](int item){ result.push_back(item); });
+    return result;
+}
+
+void testPipelinePastTheEnd(){
+    CustomCollection<int> collection;
+    for(int i = 1; i <= 7; i++){
+        collection.add(i);
+    }
+    CustomCollection<int> empty;
+    auto square = [](const int &item){ return item * item; };
+    auto odd = [](const int &item){ return item % 2 == 1; };
+
+    CHECK(exhaustedAndThrows(lazy(collection)));
+    CHECK(exhaustedAndThrows(lazy(empty)));
+    CHECK(exhaustedAndThrows(lazy(collection).map(square)));
+    CHECK(exhaustedAndThrows(lazy(collection).filter(odd)));
+    CHECK(exhaustedAndThrows(lazy(collection).map(square).filter(odd)));//上游返回值，FilterStage暂存一份值
+    CHECK(exhaustedAndThrows(lazy(collection).take(3)));
+    CHECK(exhaustedAndThrows(lazy(collection).take(0)));
+    CHECK(exhaustedAndThrows(lazy(collection).skip(5)));
+    CHECK(exhaustedAndThrows(lazy(collection).skip(100)));
+    CHECK(exhaustedAndThrows(lazy(collection).zip(lazy(empty))));
+    CHECK(exhaustedAndThrows(lazy(collection).zip(lazy(collection).skip(2))));
+    CHECK(exhaustedAndThrows(lazy(collection).chunk<3>()));
+    CustomCollection<int>::ForwardIterator iterator(collection);
+    CHECK(exhaustedAndThrows(lazy(iterator).take(4)));
+
+    //越界约定不改变正常遍历的结果
+    CHECK((collect(lazy(collection).filter(odd).map(square)) == std::vector<int>{1, 9, 25, 49}));
+    CHECK((collect(lazy(collection).skip(2).take(3)) == std::vector<int>{3, 4, 5}));
+    CHECK(lazy(collection).zip(lazy(collection).skip(2)).count() == 5);
+    std::vector<std::size_t> chunkSizes;
+    lazy(collection).chunk<3>().forEach([&chunkSizes](const Chunk<int, 3> &chunk){ chunkSizes.push_back(chunk.count); });
+    CHECK((chunkSizes == std::vector<std::size_t>{3, 3, 1}));
+}
+
+//trySplit()拆出前一半、自己保留后一半，不足两个元素时不拆分；拆出的两部分合起来恰好覆盖原区间
+void testSplitIterator(){
+    CustomCollection<int> collection;
+    for(int i = 0; i < 5; i++){
+        collection.add(i);
+    }
+    auto suffix = collection.createSplitIterator();
+    CHECK(suffix.estimateSize() == 5);
+    std::optional<CustomCollection<int>::SplitIterator> prefix = suffix.trySplit();
+    CHECK(prefix.has_value());
+    CHECK(prefix->estimateSize() == 2);
+    CHECK(suffix.estimateSize() == 3);
+    std::vector<int> seen;
+    prefix->forEachRemaining([&seen](const int &item){ seen.push_back(item); });
+    CHECK(!prefix->hasNext());
+    CHECK(prefix->estimateSize() == 0);
+    CHECK(!prefix->trySplit().has_value());
+    CHECK(suffix.next() == 2);
+    int buffer[4] = {};
+    CHECK(suffix.nextBatch(buffer, 4) == 2);
+    seen.push_back(buffer[0]);
+    seen.push_back(buffer[1]);
+    CHECK((seen == std::vector<int>{0, 1, 3, 4}));
+    CHECK(suffix.nextBatch(buffer, 4) == 0);
+    bool threw = false;
+    try{
+        suffix.next();
+    }catch(const std::out_of_range &){
+        threw = true;
+    }
+    CHECK(threw);
+
+    CustomCollection<int> single;
+    single.add(7);
+    auto only = single.createSplitIterator();
+    CHECK(!only.trySplit().has_value());
+    CHECK(only.estimateSize() == 1);
+}
+
+//每个元素恰好被访问一次，包括minChunk不大于0、集合比minChunk小和空集合的情况
+void testParallelForEach(){
+    ThreadPool pool(3);
+    for(int size : {0, 1, 3, 17, 5000}){
+        CustomCollection<int> collection;
+        for(int i = 0; i < size; i++){
+            collection.add(i);
+        }
+        for(int minChunk : {-1, 0, 1, 2, 64, 4096}){
+            auto visits = std::make_unique<std::atomic<int>[]>(size + 1);
+            collection.parallelForEach([&visits](const int &item){
+                visits[item]++;
+            }, pool, minChunk);
+            int wrong = 0;
+            for(int i = 0; i < size; i++){
+                wrong += visits[i].load() == 1 ? 0 : 1;
+            }
+            CHECK(wrong == 0);
+        }
+    }
+}
+
+//func抛出的异常在所有子区间结束后重新抛出；在线程池任务中嵌套调用不会死锁
+void testParallelForEachErrors(){
+    ThreadPool pool(2);
+    CustomCollection<int> collection;
+    for(int i = 0; i < 1000; i++){
+        collection.add(i);
+    }
+    std::atomic<int> visited{0};
+    bool threw = false;
+    try{
+        collection.parallelForEach([&visited](const int &item){
+            visited++;
+            if(item % 100 == 7){
+                throw std::runtime_error("visit failed");
+            }
+        }, pool, 10);
+    }catch(const std::runtime_error &){
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(visited.load() >= 10);//一个子区间内抛出异常后剩下的元素被跳过，其他子区间照常完成
+
+    std::atomic<long> total{0};
+    pool.forEachChunk(4, [&collection, &pool, &total](std::size_t, std::size_t){
+        collection.parallelForEach([&total](const int &item){
+            total += item;
+        }, pool, 10);
+    });
+    CHECK(total.load() == 4L * 999 * 1000 / 2);
+}
+
+//每一列是独立的连续数组：column<I>()只暴露第I个字段，按行访问时从各列组装tuple
+void testSoACollection(){
+    SoACollection<int, double, std::string> collection;
+    CHECK(collection.size() == 0);
+    CHECK(collection.column<0>().size() == 0);
+    CHECK(collection.column<2>().begin() == collection.column<2>().end());
+    collection.reserve(4);
+    collection.add(1, 0.5, "one");
+    collection.add(2, 1.5, "two");
+    collection.add(3, 2.5, "three");
+    CHECK(collection.size() == 3);
+
+    ColumnView<int> ids = collection.column<0>();
+    ColumnView<double> weights = collection.column<1>();
+    CHECK(ids.size() == 3);
+    CHECK(ids.end() - ids.begin() == 3);
+    CHECK(ids[0] == 1 && ids[2] == 3);
+    CHECK(reduction::sum(ids.begin(), ids.size()) == 6);
+    double total = 0;
+    for(double weight : weights){
+        total += weight;
+    }
+    CHECK(total == 4.5);
+    CHECK(collection.column<2>()[1] == "two");
+
+    CHECK((collection.get(1) == std::make_tuple(2, 1.5, std::string("two"))));
+    bool threw = false;
+    try{
+        collection.get(3);
+    }catch(const std::out_of_range &){
+        threw = true;
+    }
+    CHECK(threw);
+
+    //堆上的迭代器和内联迭代器都按行遍历
+    std::unique_ptr<Iterator<std::tuple<int, double, std::string>>> iterator = collection.createIterator();
+    int rows = 0;
+    while(iterator->hasNext()){
+        CHECK(std::get<0>(iterator->next()) == ++rows);
+    }
+    CHECK(rows == 3);
+    auto handle = collection.createInlineIterator();
+    CHECK(handle.isInline());
+    CHECK(std::get<2>(handle->next()) == "one");
+
+    //作为Aggregate批量追加到CustomCollection
+    CustomCollection<std::tuple<int, double, std::string>> rowsCopy;
+    rowsCopy.addAll(collection);
+    CHECK(rowsCopy.size() == 3);
+    CHECK(std::get<2>(rowsCopy.get(2)) == "three");
+}
+
+}
+
+int main(){
+    testing::run("reduction kernels at every tail length and offset", testReductionKernels);
+    testing::run("CustomCollection sum/min/max/dot/countIf", testCollectionReductions);
+    testing::run("pipeline stages throw past the end", testPipelinePastTheEnd);
+    testing::run("SplitIterator trySplit/forEachRemaining/nextBatch", testSplitIterator);
+    testing::run("parallelForEach visits every element once", testParallelForEach);
+    testing::run("parallelForEach rethrows and nests in the pool", testParallelForEachErrors);
+    testing::run("SoACollection columns and rows", testSoACollection);
+    return testing::failures();
+}
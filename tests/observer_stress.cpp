@@ -0,0 +1,147 @@
+#include "../observer/observer.h"
+#include "test.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+//并发主题的压力测试：若干线程随机注册、注销各自的观察者，另外若干线程同时setState()/notify()
+//除了最后对照计数检查外，主要用途是在ThreadSanitizer下运行（observer_stress_tsan），暴露数据竞争
+//观察者在投递线程上只修改原子变量，违反约定的次数汇总后在主线程中CHECK
+namespace{
+
+constexpr int MutatorCount = 2;
+constexpr int NotifierCount = 2;
+constexpr int MembersPerMutator = 16;
+constexpr int Operations = 4000;
+
+class CountingObserver : public Observer{
+    public:
+        std::atomic<int> updates{0};
+        std::atomic<bool> closed{false};//外部线程的detach()已经返回
+        std::atomic<int> lateUpdates{0};//closed之后仍然收到的通知
+
+        void update(Subject* subject) override{
+            subject->getState();
+            if(closed.load(std::memory_order_acquire)){
+                lateUpdates++;
+            }
+            updates++;
+        }
+};
+
+struct Member{
+    CountingObserver observer;
+    Subscription subscription{};
+    bool attached = false;
+};
+
+//每个注册线程只操作自己的一组观察者，注销后把closed置位；notify()线程只发布状态
+template<typename SubjectType, typename Publish>
+void stress(SubjectType &subject, Publish publish){
+    std::vector<std::vector<Member>> groups(MutatorCount);
+    for(auto &group : groups){
+        group = std::vector<Member>(MembersPerMutator);
+    }
+    std::atomic<int> running{MutatorCount};
+    std::vector<std::thread> threads;
+    for(int m = 0; m < MutatorCount; m++){
+        threads.emplace_back([&subject, &group = groups[m], &running, m]{
+            std::mt19937 random(static_cast<unsigned>(m + 1));
+            for(int i = 0; i < Operations; i++){
+                Member &member = group[random() % group.size()];
+                if(!member.attached){
+                    member.observer.closed.store(false, std::memory_order_release);
+                    member.subscription = subject.attach(&member.observer);
+                    member.attached = true;
+                }else{
+                    if(random() % 2 == 0){
+                        subject.detach(member.subscription);
+                    }else{
+                        subject.detach(&member.observer);
+                    }
+                    member.attached = false;
+                    member.observer.closed.store(true, std::memory_order_release);
+                }
+            }
+            running--;
+        });
+    }
+    for(int n = 0; n < NotifierCount; n++){
+        threads.emplace_back([&publish, &running, n]{
+            int state = n * Operations;
+            while(running.load() > 0){
+                publish(state++);
+            }
+        });
+    }
+    for(auto &thread : threads){
+        thread.join();
+    }
+    for(auto &group : groups){
+        for(Member &member : group){
+            if(member.attached){
+                subject.detach(member.subscription);
+                member.observer.closed.store(true, std::memory_order_release);
+            }
+        }
+    }
+    int total = 0;
+    for(auto &group : groups){
+        for(Member &member : group){
+            CHECK(member.observer.lateUpdates.load() == 0);
+            total += member.observer.updates.load();
+        }
+    }
+    //全部注销之后的通知不会再到达任何观察者
+    publish(-1);
+    int after = 0;
+    for(auto &group : groups){
+        for(Member &member : group){
+            after += member.observer.updates.load();
+        }
+    }
+    CHECK(after == total);
+}
+
+void testConcurrentSubject(){
+    ConcurrentSubject subject;
+    stress(subject, [&subject](int state){
+        subject.setState(state);
+        subject.notify();
+    });
+}
+
+void testAsyncSubject(BackpressurePolicy policy){
+    AsyncSubject subject(policy, 2);
+    stress(subject, [&subject](int state){
+        subject.setState(state);
+        if(state < 0){
+            subject.waitIdle();
+        }
+    });
+}
+
+void testBusSubject(){
+    EventBus bus(2);
+    BusSubject subject(bus);
+    stress(subject, [&subject, &bus](int state){
+        subject.setState(state);
+        subject.notify();
+        if(state < 0){
+            bus.waitIdle();
+        }
+    });
+}
+
+}
+
+int main(){
+    testing::run("ConcurrentSubject concurrent attach/detach/notify", testConcurrentSubject);
+    testing::run("AsyncSubject LatestWins concurrent attach/detach/setState", []{ testAsyncSubject(BackpressurePolicy::LatestWins); });
+    testing::run("AsyncSubject Block concurrent attach/detach/setState", []{ testAsyncSubject(BackpressurePolicy::Block); });
+    testing::run("AsyncSubject DropNewest concurrent attach/detach/setState", []{ testAsyncSubject(BackpressurePolicy::DropNewest); });
+    testing::run("BusSubject concurrent subscribe/unsubscribe/publish", testBusSubject);
+    return testing::failures();
+}
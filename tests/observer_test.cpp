@@ -0,0 +1,425 @@
+#include "../observer/observer.h"
+#include "test.h"
+
+#include <atomic>
+#include <climits>
+#include <random>
+#include <vector>
+
+//同步主题的随机测试：观察者在update()中随机注册、注销其他观察者或自己，偶尔抛出异常
+//每轮通知后对照模型检查：
+//- 本轮开始前已注册、且轮到它之前没有被注销的观察者恰好收到一次通知
+//- 已注销的观察者和本轮中新注册的观察者收不到通知
+//- 抛出异常时推迟的修改不会丢失，下一轮照常通过上面的检查
+namespace{
+
+constexpr int Rounds = 2000;
+constexpr std::size_t MemberCount = 32;
+
+class ConcreteHarness{
+    private:
+        struct Member : Observer{
+            ConcreteHarness *harness = nullptr;
+            bool attached = false;
+            bool subscribed = false;//subscription是否来自一次真正的注册
+            Subscription subscription{};
+            int attachedRound = 0;
+            int deliveredRound = 0;
+
+            void update(Subject* subject) override{
+                harness->onUpdate(*this, subject);
+            }
+        };
+
+        ConcreteSubject subject;
+        std::vector<Member> members;
+        std::mt19937 random;
+        int round = 0;
+
+        void attach(Member &member){
+            member.subscription = subject.attach(&member);
+            member.attached = true;
+            member.subscribed = true;
+            member.attachedRound = round;
+        }
+
+        //按句柄和按指针两种方式注销
+        void detach(Member &member){
+            if(random() % 2 == 0){
+                subject.detach(member.subscription);
+            }else{
+                subject.detach(&member);
+            }
+            member.attached = false;
+        }
+
+        void mutate(){
+            Member &member = members[random() % members.size()];
+            if(member.attached){
+                detach(member);
+                return;
+            }
+            //过期的句柄可能指向已被复用的槽位，注销时必须什么也不做
+            if(member.subscribed && random() % 4 == 0){
+                subject.detach(member.subscription);
+            }
+            attach(member);
+        }
+
+        void onUpdate(Member &member, Subject* from){
+            CHECK(from == &subject);
+            CHECK(member.attached);
+            CHECK(member.attachedRound < round);
+            CHECK(member.deliveredRound != round);
+            member.deliveredRound = round;
+            for(unsigned i = random() % 3; i > 0; i--){
+                mutate();
+            }
+            if(random() % 20 == 0){
+                throw std::runtime_error("update failed");
+            }
+        }
+
+    public:
+        explicit ConcreteHarness(unsigned seed) : members(MemberCount), random(seed){
+            for(Member &member : members){
+                member.harness = this;
+            }
+            subject.setChangeThreshold(-1);//每次notify()都通知
+        }
+
+        void run(){
+            for(int i = 0; i < Rounds; i++){
+                for(unsigned j = random() % 4; j > 0; j--){
+                    mutate();
+                }
+                round++;
+                bool threw = false;
+                try{
+                    subject.notify();
+                }catch(const std::runtime_error &){
+                    threw = true;
+                }
+                std::size_t attached = 0;
+                for(const Member &member : members){
+                    if(!member.attached){
+                        continue;
+                    }
+                    attached++;
+                    if(!threw && member.attachedRound < round){
+                        CHECK(member.deliveredRound == round);
+                    }
+                }
+                CHECK(subject.size() == attached);
+            }
+        }
+};
+
+struct TopicEvent{
+    int topic;
+    int value;
+};
+
+//TopicSubject在此基础上还检查主题、谓词过滤和按优先级从高到低的投递顺序
+class TopicHarness{
+    private:
+        enum class Kind{ Topic, All, Predicate };
+
+        struct Member : EventObserver<TopicEvent>{
+            TopicHarness *harness = nullptr;
+            bool attached = false;
+            bool subscribed = false;//subscription是否来自一次真正的注册
+            Subscription subscription{};
+            int attachedRound = 0;
+            int deliveredRound = 0;
+            Kind kind = Kind::Topic;
+            int topic = 0;
+            int parity = 0;
+            int priority = 0;
+
+            bool accepts(const TopicEvent &event) const{
+                switch(kind){
+                    case Kind::Topic:
+                        return event.topic == topic;
+                    case Kind::All:
+                        return true;
+                    default:
+                        return event.value % 2 == parity;
+                }
+            }
+
+            void update(const TopicEvent &event) override{
+                harness->onUpdate(*this, event);
+            }
+        };
+
+        static constexpr int TopicCount = 3;//第4个主题没有订阅者，对应的桶不存在
+
+        TopicSubject<TopicEvent> subject;
+        std::vector<Member> members;
+        std::mt19937 random;
+        int round = 0;
+        int lastPriority = INT_MAX;
+
+        void attach(Member &member){
+            member.kind = static_cast<Kind>(random() % 3);
+            member.topic = static_cast<int>(random() % TopicCount);
+            member.parity = static_cast<int>(random() % 2);
+            member.priority = static_cast<int>(random() % 5);
+            switch(member.kind){
+                case Kind::Topic:
+                    member.subscription = subject.attach(&member, member.topic, member.priority);
+                    break;
+                case Kind::All:
+                    member.subscription = subject.attachAll(&member, member.priority);
+                    break;
+                default:{
+                    int parity = member.parity;
+                    member.subscription = subject.attachIf(&member, [parity](const TopicEvent &event){
+                        return event.value % 2 == parity;
+                    }, member.priority);
+                }
+            }
+            member.attached = true;
+            member.subscribed = true;
+            member.attachedRound = round;
+        }
+
+        void mutate(){
+            Member &member = members[random() % members.size()];
+            if(member.attached){
+                subject.detach(member.subscription);
+                member.attached = false;
+                return;
+            }
+            if(member.subscribed && random() % 4 == 0){
+                subject.detach(member.subscription);
+            }
+            attach(member);
+        }
+
+        void onUpdate(Member &member, const TopicEvent &event){
+            CHECK(member.attached);
+            CHECK(member.attachedRound < round);
+            CHECK(member.deliveredRound != round);
+            CHECK(member.accepts(event));
+            CHECK(member.priority <= lastPriority);
+            member.deliveredRound = round;
+            lastPriority = member.priority;
+            for(unsigned i = random() % 3; i > 0; i--){
+                mutate();
+            }
+            if(random() % 20 == 0){
+                throw std::runtime_error("update failed");
+            }
+        }
+
+    public:
+        explicit TopicHarness(unsigned seed) : members(MemberCount), random(seed){
+            for(Member &member : members){
+                member.harness = this;
+            }
+        }
+
+        void run(){
+            for(int i = 0; i < Rounds; i++){
+                for(unsigned j = random() % 4; j > 0; j--){
+                    mutate();
+                }
+                round++;
+                lastPriority = INT_MAX;
+                TopicEvent event{static_cast<int>(random() % (TopicCount + 1)), static_cast<int>(random() % 100)};
+                bool threw = false;
+                try{
+                    subject.notify(event.topic, event);
+                }catch(const std::runtime_error &){
+                    threw = true;
+                }
+                if(threw){
+                    continue;
+                }
+                for(const Member &member : members){
+                    if(member.attached && member.attachedRound < round && member.accepts(event)){
+                        CHECK(member.deliveredRound == round);
+                    }
+                }
+            }
+        }
+};
+
+//在update()中注销另一个主题上的观察者，两个主题共用一个单线程的线程池
+class CrossDetachObserver : public Observer{
+    public:
+        Subject *target = nullptr;
+        Observer *victim = nullptr;
+        std::atomic<int> updates{0};
+
+        void update(Subject*) override{
+            updates++;
+            if(target != nullptr){
+                target->detach(victim);
+                target = nullptr;
+            }
+        }
+};
+
+void testConcreteSubjectRandom(){
+    for(unsigned seed = 1; seed <= 4; seed++){
+        ConcreteHarness(seed).run();
+    }
+}
+
+void testTopicSubjectRandom(){
+    for(unsigned seed = 1; seed <= 4; seed++){
+        TopicHarness(seed).run();
+    }
+}
+
+//ConcurrentSubject：update()中注销自己不等待宽限期；waitIdle()在update()中调用时抛出异常，在外部调用后不再投递
+void testConcurrentDetachFromUpdate(){
+    class SelfDetachObserver : public Observer{
+        public:
+            int updates = 0;
+            bool waitIdleThrew = false;
+
+            void update(Subject* subject) override{
+                updates++;
+                auto &concurrent = static_cast<ConcurrentSubject&>(*subject);
+                concurrent.detach(this);
+                try{
+                    concurrent.waitIdle();
+                }catch(const std::logic_error &){
+                    waitIdleThrew = true;
+                }
+            }
+    };
+
+    ConcurrentSubject subject;
+    SelfDetachObserver observer;
+    for(int i = 0; i < 20; i++){
+        subject.attach(&observer);
+        subject.notify();
+    }
+    subject.waitIdle();
+    subject.notify();
+    CHECK(observer.updates == 20);
+    CHECK(observer.waitIdleThrew);
+}
+
+//投递线程上的detach()不能等待排在同一线程后面的投递，否则会死锁
+void testAsyncCrossDetach(){
+    ThreadPool pool(1);
+    for(int i = 0; i < 200; i++){
+        AsyncSubject first(BackpressurePolicy::LatestWins, 1, pool);
+        AsyncSubject second(BackpressurePolicy::LatestWins, 1, pool);
+        CrossDetachObserver a;
+        CrossDetachObserver b;
+        a.target = &second;
+        a.victim = &b;
+        b.target = &first;
+        b.victim = &a;
+        first.attach(&a);
+        second.attach(&b);
+        first.setState(i);
+        second.setState(i);
+        first.waitIdle();
+        second.waitIdle();
+        CHECK(a.updates.load() + b.updates.load() >= 1);
+        CHECK(a.updates.load() <= 1);
+        CHECK(b.updates.load() <= 1);
+    }
+}
+
+//在update()中注销自己：之后的setState()不会再投递给它
+void testAsyncSelfDetach(){
+    class SelfDetachObserver : public Observer{
+        public:
+            std::atomic<int> updates{0};
+
+            void update(Subject* subject) override{
+                updates++;
+                subject->detach(this);
+            }
+    };
+
+    AsyncSubject subject(BackpressurePolicy::Block, 4);
+    SelfDetachObserver observer;
+    subject.attach(&observer);
+    for(int i = 0; i < 100; i++){
+        subject.setState(i);
+    }
+    subject.waitIdle();
+    int updates = observer.updates.load();
+    CHECK(updates >= 1);
+    subject.setState(-1);
+    subject.waitIdle();
+    CHECK(observer.updates.load() == updates);
+}
+
+//EventBus：注销后压缩列表也保持注册顺序；在update()中注销只影响之后的事件
+void testBusOrderAndDetachFromUpdate(){
+    class RecordingObserver : public Observer{
+        public:
+            std::vector<int> *log = nullptr;
+            int name = 0;
+            EventBus *bus = nullptr;
+            Subscription victim{};
+            bool detachVictim = false;
+
+            void update(Subject* subject) override{
+                log->push_back(name * 1000 + subject->getState());
+                if(detachVictim){
+                    bus->unsubscribe(victim);
+                    detachVictim = false;
+                }
+            }
+    };
+
+    EventBus bus(1);
+    BusSubject subject(bus);
+    std::vector<int> log;
+    std::vector<RecordingObserver> observers(12);
+    std::vector<Subscription> subscriptions;
+    for(std::size_t i = 0; i < observers.size(); i++){
+        observers[i].log = &log;
+        observers[i].name = static_cast<int>(i);
+        observers[i].bus = &bus;
+    }
+    for(std::size_t i = 0; i < 10; i++){
+        subscriptions.push_back(subject.attach(&observers[i]));
+    }
+    //注销超过一半，触发压缩
+    for(std::size_t i = 0; i < 10; i += 2){
+        subject.detach(subscriptions[i]);
+    }
+    subject.detach(subscriptions[3]);
+    subject.attach(&observers[10]);
+    subject.attach(&observers[11]);
+    subject.setState(1);
+    subject.notify();
+    bus.waitIdle();
+    CHECK((log == std::vector<int>{1001, 5001, 7001, 9001, 10001, 11001}));
+
+    //1号在update()中注销9号：9号仍然收到这一次事件，但收不到下一次
+    log.clear();
+    observers[1].victim = subscriptions[9];
+    observers[1].detachVictim = true;
+    subject.setState(2);
+    subject.notify();
+    subject.setState(3);
+    subject.notify();
+    bus.waitIdle();
+    CHECK((log == std::vector<int>{1002, 5002, 7002, 9002, 10002, 11002, 1003, 5003, 7003, 10003, 11003}));
+}
+
+}
+
+int main(){
+    testing::run("ConcreteSubject random attach/detach during notify", testConcreteSubjectRandom);
+    testing::run("TopicSubject random attach/detach during notify", testTopicSubjectRandom);
+    testing::run("ConcurrentSubject detach from update and waitIdle()", testConcurrentDetachFromUpdate);
+    testing::run("AsyncSubject detach across subjects on one delivery thread", testAsyncCrossDetach);
+    testing::run("AsyncSubject detach from update", testAsyncSelfDetach);
+    testing::run("EventBus registration order and detach from update", testBusOrderAndDetachFromUpdate);
+    return testing::failures();
+}
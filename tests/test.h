@@ -0,0 +1,46 @@
+#ifndef TESTS_TEST_H
+#define TESTS_TEST_H
+
+#include <cstdio>
+#include <exception>
+
+//极简的测试辅助：CHECK失败时打印位置并计数，不中断后续检查；main()用failures()作为退出码
+namespace testing{
+
+inline int& failureCount(){
+    static int count = 0;
+    return count;
+}
+
+inline void fail(const char* expression, const char* file, int line){
+    std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+    failureCount()++;
+}
+
+//依次运行各个测试用例，用例抛出异常也算失败
+template<typename Func>
+void run(const char* name, Func func){
+    int before = failureCount();
+    try{
+        func();
+    }catch(const std::exception &error){
+        std::fprintf(stderr, "%s: unexpected exception: %s\n", name, error.what());
+        failureCount()++;
+    }
+    std::fprintf(stderr, "[%s] %s\n", failureCount() == before ? "  OK  " : "FAILED", name);
+}
+
+inline int failures(){
+    return failureCount() == 0 ? 0 : 1;
+}
+
+}
+
+#define CHECK(condition) \
+    do{ \
+        if(!(condition)){ \
+            ::testing::fail(#condition, __FILE__, __LINE__); \
+        } \
+    }while(0)
+
+#endif
@@ -0,0 +1,448 @@
+#include "../visitor/visitor.h"
+#include "test.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+//访问者模块的测试：名字驻留、并行访问的结果合并与异常传播、arena的reset()、
+//增量访问的epoch与修改记录、内存映射镜像的格式检查
+namespace{
+
+//按名字统计；名字为"bad"的动物让visit()抛出异常
+class CountingVisitor : public ParallelAnimalVisitor{
+    public:
+        std::size_t lions = 0;
+        std::size_t tigers = 0;
+
+        void visit(const Lion& lion) override{
+            if(lion.getName() == "bad"){
+                throw std::runtime_error("bad lion");
+            }
+            lions++;
+        }
+
+        void visit(const Tiger&) override{
+            tigers++;
+        }
+
+        std::unique_ptr<ParallelAnimalVisitor> fork() const override{
+            return std::make_unique<CountingVisitor>();
+        }
+
+        void merge(const ParallelAnimalVisitor& other) override{
+            const auto &partial = static_cast<const CountingVisitor&>(other);
+            lions += partial.lions;
+            tigers += partial.tigers;
+        }
+};
+
+//lionCount只Lion放在连续数组中；tigerCount只Tiger中一半放在连续数组中，另一半通过makeAnimal()/addAnimal()单独加入
+void populate(Zoo &zoo, std::size_t lionCount, std::size_t tigerCount){
+    for(std::size_t i = 0; i < lionCount; i++){
+        zoo.emplaceAnimal<Lion>("lion" + std::to_string(i % 10));
+    }
+    for(std::size_t i = 0; i < tigerCount; i++){
+        if(i % 4 == 0){
+            zoo.makeAnimal<Tiger>("tiger");
+        }else if(i % 4 == 1){
+            zoo.addAnimal(std::make_unique<Tiger>(zoo.names(), "tiger"));
+        }else{
+            zoo.emplaceAnimal<Tiger>("tiger");
+        }
+    }
+}
+
+//内容相同的名字返回同一个view，查找表扩容后以前返回的view仍然有效；addLion()/addTiger()使用Zoo的名字表
+void testNameTable(){
+    std::pmr::monotonic_buffer_resource arena;
+    NameTable table(&arena);
+    std::string_view empty = table.intern("");
+    std::string_view first = table.intern("Simba");
+    CHECK(first == "Simba");
+    std::vector<std::string_view> views;
+    for(int i = 0; i < 1000; i++){
+        views.push_back(table.intern("name" + std::to_string(i)));
+    }
+    CHECK(table.size() == 1002);
+    CHECK(table.intern("Simba").data() == first.data());
+    CHECK(table.intern(std::string_view()).data() == empty.data());
+    CHECK(table.intern("").empty());
+    int moved = 0;
+    for(int i = 0; i < 1000; i++){
+        std::string name = "name" + std::to_string(i);
+        moved += views[i] == name && table.intern(name).data() == views[i].data() ? 0 : 1;
+    }
+    CHECK(moved == 0);
+    table.reserve(5000);
+    CHECK(table.intern("name7").data() == views[7].data());
+    CHECK(table.size() == 1002);
+    table.clear();
+    CHECK(table.size() == 0);
+    CHECK(table.intern("Simba") == "Simba");
+
+    Zoo zoo;
+    zoo.reserve(2, 1, 2);
+    Lion &simba = zoo.addLion("Simba");
+    zoo.addLion("Nala");
+    Tiger &rajah = zoo.addTiger("Simba");
+    CHECK(simba.getName().data() == rajah.getName().data());
+    CHECK(zoo.names().size() == 2);
+    FoodQuotaVisitor visitor;
+    zoo.accept(visitor);
+    CHECK(visitor.getLionCount() == 2 && visitor.getTigerCount() == 1);
+}
+
+//并行访问与顺序访问的结果相同，包括minChunk为0、动物比线程少和空Zoo
+void testParallelAcceptMerge(){
+    ThreadPool pool(3);
+    for(std::size_t count : {0, 1, 5, 1000}){
+        Zoo zoo;
+        populate(zoo, count, count / 2 + 1);
+        FoodQuotaVisitor sequential;
+        zoo.accept(sequential);
+        for(std::size_t minChunk : {0, 1, 7, 4096}){
+            FoodQuotaVisitor parallel;
+            zoo.parallelAccept(parallel, pool, minChunk);
+            CHECK(parallel.getLionCount() == sequential.getLionCount());
+            CHECK(parallel.getTigerCount() == sequential.getTigerCount());
+            CHECK(parallel.getMeat() == sequential.getMeat());
+        }
+    }
+}
+
+//visit()抛出的异常在所有块结束后重新抛出，原访问者不合并任何副本；之后同一访问者可以继续使用
+void testParallelAcceptException(){
+    ThreadPool pool(3);
+    Zoo zoo;
+    populate(zoo, 500, 300);
+    zoo.emplaceAnimal<Lion>("bad");
+    CountingVisitor visitor;
+    visitor.tigers = 1;
+    bool threw = false;
+    try{
+        zoo.parallelAccept(visitor, pool, 16);
+    }catch(const std::runtime_error &){
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(visitor.lions == 0);
+    CHECK(visitor.tigers == 1);
+
+    //在线程池任务中嵌套调用：调用方线程自己也领取块，不会等待被占满的线程池
+    Zoo clean;
+    populate(clean, 200, 100);
+    std::vector<CountingVisitor> results(4);
+    pool.forEachChunk(results.size(), [&clean, &pool, &results](std::size_t index, std::size_t){
+        clean.parallelAccept(results[index], pool, 8);
+    });
+    for(const CountingVisitor &result : results){
+        CHECK(result.lions == 200);
+        CHECK(result.tigers == 100);
+    }
+}
+
+//记录上游还有多少字节没有归还，检查arena是否把内存整块还回去
+class CountingResource : public std::pmr::memory_resource{
+    public:
+        std::size_t outstanding = 0;
+        std::size_t allocations = 0;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override{
+            outstanding += bytes;
+            allocations++;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override{
+            outstanding -= bytes;
+            std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override{
+            return this == &other;
+        }
+};
+
+//makeAnimal()构造在arena中的自定义动物，析构时计数
+class Keeper : public Animal{
+    public:
+        int *destroyed;
+
+        explicit Keeper(int *destroyed) : destroyed(destroyed){}
+
+        ~Keeper() override{
+            (*destroyed)++;
+        }
+
+        void accept(AnimalVisitor&) const override{}
+};
+
+//reset()销毁全部动物、清空名字表，把arena的内存全部还给上游；之后Zoo可以照常使用，析构时同样全部归还
+void testArenaReset(){
+    CountingResource upstream;
+    int destroyed = 0;
+    {
+        Zoo zoo(&upstream);
+        populate(zoo, 300, 200);
+        zoo.makeAnimal<Keeper>(&destroyed);
+        zoo.makeAnimal<Keeper>(&destroyed);
+        CHECK(upstream.outstanding > 0);
+        CHECK(zoo.names().size() == 11);
+
+        zoo.reset();
+        CHECK(destroyed == 2);
+        CHECK(upstream.outstanding == 0);
+        CHECK(zoo.size() == 0);
+        CHECK(zoo.names().size() == 0);
+        FoodQuotaVisitor empty;
+        zoo.accept(empty);
+        CHECK(empty.getLionCount() == 0 && empty.getTigerCount() == 0);
+
+        //reset()之后重新使用，名字重新驻留在新的arena内存中
+        std::size_t allocations = upstream.allocations;
+        zoo.reserve(10, 10);
+        for(int i = 0; i < 10; i++){
+            zoo.emplaceAnimal<Lion>("again");
+        }
+        zoo.makeAnimal<Keeper>(&destroyed);
+        CHECK(upstream.allocations > allocations);
+        CHECK(zoo.getLions().back().getName() == "again");
+        CHECK(zoo.names().size() == 1);
+        FoodQuotaVisitor visitor;
+        zoo.accept(visitor);
+        CHECK(visitor.getLionCount() == 10);
+    }
+    CHECK(destroyed == 3);
+    CHECK(upstream.outstanding == 0);
+}
+
+//Zoo中全部名字的总长度，作为NameIndexVisitor的参照
+std::size_t nameLength(Zoo &zoo){
+    NameLengthVisitor visitor;
+    zoo.accept(visitor);
+    return visitor.getTotal();
+}
+
+//只访问新加入和markModified()的动物；扩容、reset()、换了Zoo或修改记录过多时从头计算
+void testAcceptIncremental(){
+    Zoo zoo;
+    zoo.reserve(16, 16);
+    populate(zoo, 4, 4);
+    NameIndexVisitor index;
+    zoo.acceptIncremental(index);
+    CHECK(index.getVisits() == 8);
+    CHECK(index.getTotal() == nameLength(zoo));
+
+    //没有变化时什么也不访问
+    zoo.acceptIncremental(index);
+    CHECK(index.getVisits() == 8);
+
+    //容量足够时加入的动物只访问新的那几只，包括连续数组外的动物
+    Lion &newcomer = zoo.emplaceAnimal<Lion>("newcomer");//之后不再加入Lion，引用一直有效
+    zoo.makeAnimal<Tiger>("stray");
+    zoo.acceptIncremental(index);
+    CHECK(index.getVisits() == 10);
+    CHECK(index.getTotal() == nameLength(zoo));
+
+    //改名后标记，只重新访问这一只，旧的缓存结果被覆盖
+    newcomer.setName(zoo.names(), "a much longer name");
+    zoo.markModified(newcomer);
+    zoo.acceptIncremental(index);
+    CHECK(index.getVisits() == 11);
+    CHECK(index.getTotal() == nameLength(zoo));
+
+    //连续数组扩容改变了已有动物的地址（newcomer也随之失效），从头计算
+    std::size_t size = zoo.size();
+    std::size_t visits = index.getVisits();
+    while(zoo.getLions().size() < zoo.getLions().capacity()){
+        zoo.emplaceAnimal<Lion>("filler");
+    }
+    zoo.emplaceAnimal<Lion>("overflow");
+    zoo.acceptIncremental(index);
+    CHECK(index.getVisits() == visits + zoo.size());
+    CHECK(zoo.size() > size);
+    CHECK(index.getTotal() == nameLength(zoo));
+
+    //修改记录比动物还多时丢弃记录，同样从头计算
+    visits = index.getVisits();
+    for(std::size_t i = 0; i <= zoo.size(); i++){
+        zoo.markModified(zoo.getTigers().front());
+    }
+    zoo.acceptIncremental(index);
+    CHECK(index.getVisits() == visits + zoo.size());
+
+    //同一个访问者换一个Zoo，epoch不同，从头计算
+    Zoo other;
+    populate(other, 3, 0);
+    visits = index.getVisits();
+    other.acceptIncremental(index);
+    CHECK(index.getVisits() == visits + 3);
+    CHECK(index.getTotal() == nameLength(other));
+
+    //reset()之后旧地址全部失效
+    zoo.acceptIncremental(index);
+    zoo.reset();
+    populate(zoo, 2, 0);
+    visits = index.getVisits();
+    zoo.acceptIncremental(index);
+    CHECK(index.getVisits() == visits + 2);
+    CHECK(index.getTotal() == nameLength(zoo));
+}
+
+//依次记录访问到的名字
+class NameListVisitor : public AnimalVisitor{
+    public:
+        std::vector<std::string> names;
+
+        void visit(const Lion& lion) override{
+            names.push_back("L:" + std::string(lion.getName()));
+        }
+
+        void visit(const Tiger& tiger) override{
+            names.push_back("T:" + std::string(tiger.getName()));
+        }
+};
+
+//记录每条记录的地址和名字
+class RecordVisitor : public MappedAnimalVisitor{
+    public:
+        std::vector<const AnimalRecord*> records;
+        std::vector<std::string> names;
+
+        void visit(const AnimalRecord& record, std::string_view name) override{
+            records.push_back(&record);
+            names.push_back(std::string(name));
+        }
+};
+
+//MappedZoo::accept()是否接受Visitor：增量访问者按地址区分动物，对应的重载被删除
+template<typename Visitor, typename = void>
+struct MappedAcceptable : std::false_type{};
+
+template<typename Visitor>
+struct MappedAcceptable<Visitor, std::void_t<decltype(std::declval<const MappedZoo&>().accept(std::declval<Visitor&>()))>> : std::true_type{};
+
+static_assert(MappedAcceptable<NameListVisitor>::value, "plain visitors can visit a MappedZoo");
+static_assert(MappedAcceptable<RecordVisitor>::value, "record visitors can visit a MappedZoo");
+static_assert(!MappedAcceptable<NameIndexVisitor>::value, "address-keyed visitors must not visit reused views");
+
+std::string readFile(const std::string &path){
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string &path, const std::string &bytes){
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+template<typename Field>
+void patch(std::string &bytes, std::size_t offset, Field value){
+    std::memcpy(&bytes[offset], &value, sizeof(value));
+}
+
+//打开并完整遍历一次镜像，文件头或记录损坏时返回false
+bool loads(const std::string &path){
+    try{
+        MappedZoo mapped(path);
+        NameListVisitor visitor;
+        mapped.accept(visitor);
+        return true;
+    }catch(const std::runtime_error &){
+        return false;
+    }
+}
+
+//写出的镜像按accept()的顺序遍历；截断、魔数、字节序、版本、区段和记录损坏的镜像都被拒绝
+void testMappedZooImage(){
+    const std::string path = "visitor_test_image.bin";
+    const std::string damaged = "visitor_test_damaged.bin";
+    Zoo zoo;
+    zoo.emplaceAnimal<Lion>("Simba");
+    zoo.emplaceAnimal<Lion>("Nala");
+    zoo.emplaceAnimal<Tiger>("Shere Khan");
+    zoo.emplaceAnimal<Lion>("Simba");
+    ZooImageWriter::write(zoo, path);
+
+    MappedZoo mapped(path);
+    CHECK(mapped.size() == 4);
+    NameListVisitor visitor;
+    mapped.accept(visitor);
+    CHECK((visitor.names == std::vector<std::string>{"L:Simba", "L:Nala", "L:Simba", "T:Shere Khan"}));
+
+    //每条记录有自己的地址，同名的两只Lion也不会被当成同一只
+    RecordVisitor records;
+    mapped.accept(records);
+    CHECK(records.records.size() == 4);
+    for(std::size_t i = 1; i < records.records.size(); i++){
+        CHECK(records.records[i] == records.records[0] + i);
+    }
+    CHECK(records.records[0]->type == static_cast<std::uint32_t>(AnimalType::Lion));
+    CHECK(records.records[3]->type == static_cast<std::uint32_t>(AnimalType::Tiger));
+    CHECK((records.names == std::vector<std::string>{"Simba", "Nala", "Simba", "Shere Khan"}));
+
+    const std::string image = readFile(path);
+    const std::size_t header = sizeof(ZooImageHeader);
+    const std::size_t firstRecord = header;
+    CHECK(image.size() == header + 4 * sizeof(AnimalRecord) + 19);//Simba、Nala、Shere Khan各保存一次
+    auto rejected = [&damaged](const std::string &bytes){
+        writeFile(damaged, bytes);
+        return !loads(damaged);
+    };
+
+    CHECK(rejected(std::string()));
+    CHECK(rejected(image.substr(0, header - 1)));
+    CHECK(rejected(image.substr(0, header + sizeof(AnimalRecord))));//记录被截断
+    CHECK(rejected(image.substr(0, image.size() - 1)));//名字表被截断
+    std::string bytes = image;
+    bytes[0] = 'X';
+    CHECK(rejected(bytes));
+    bytes = image;
+    patch(bytes, offsetof(ZooImageHeader, byteOrder), std::uint32_t(0x04030201));
+    CHECK(rejected(bytes));
+    bytes = image;
+    patch(bytes, offsetof(ZooImageHeader, version), ZooImageVersion + 1);
+    CHECK(rejected(bytes));
+    bytes = image;
+    patch(bytes, offsetof(ZooImageHeader, recordCount), std::uint64_t(1) << 60);//乘以记录大小后溢出
+    CHECK(rejected(bytes));
+    bytes = image;
+    patch(bytes, offsetof(ZooImageHeader, namesOffset), std::uint64_t(header));
+    CHECK(rejected(bytes));
+    bytes = image;
+    patch(bytes, offsetof(ZooImageHeader, namesSize), std::uint64_t(image.size()));
+    CHECK(rejected(bytes));
+    bytes = image;
+    patch(bytes, firstRecord + offsetof(AnimalRecord, type), std::uint32_t(7));
+    CHECK(rejected(bytes));
+    bytes = image;
+    patch(bytes, firstRecord + offsetof(AnimalRecord, nameOffset), std::uint64_t(16));
+    CHECK(rejected(bytes));
+    bytes = image;
+    patch(bytes, firstRecord + offsetof(AnimalRecord, nameLength), std::uint32_t(0xffffffff));
+    CHECK(rejected(bytes));
+    CHECK(!loads("visitor_test_missing.bin"));
+
+    std::remove(path.c_str());
+    std::remove(damaged.c_str());
+}
+
+}
+
+int main(){
+    testing::run("NameTable interning and Zoo::addLion()/addTiger()", testNameTable);
+    testing::run("parallelAccept matches accept", testParallelAcceptMerge);
+    testing::run("parallelAccept rethrows without merging", testParallelAcceptException);
+    testing::run("Zoo reset() returns the arena to upstream", testArenaReset);
+    testing::run("acceptIncremental epochs and change records", testAcceptIncremental);
+    testing::run("MappedZoo reads images and rejects damaged ones", testMappedZooImage);
+    return testing::failures();
+}
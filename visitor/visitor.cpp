@@ -1,131 +1,49 @@
-#include <iostream>
-#include <string>
-#include <vector>
-#include <memory>
-
-// 前向声明
-class Lion;
-class Tiger;
-// 抽象访问者基类
-class AnimalVisitor {
-public:
-    virtual ~AnimalVisitor() = default;
-    virtual void visit(const Lion& lion) = 0;
-    virtual void visit(const Tiger& tiger) = 0;
-};
-
-// 抽象元素基类
-class Animal {
-public:
-    virtual ~Animal() = default;
-    virtual void accept(AnimalVisitor& visitor) const = 0;
-};
-
-// 具体元素类
-class Lion : public Animal {
-private:
-    std::string name;
-
-public:
-    Lion(const std::string& name) : name(name) {
-        std::cout << "Lion " << name << " created" << std::endl;
-    }
-
-    std::string getName() const {
-        return name;
-    }
-
-    void accept(AnimalVisitor& visitor) const override {
-        visitor.visit(*this);
-    }
-
-    ~Lion() {
-        std::cout << "Lion " << name << " destroyed" << std::endl;
-    }
-};
-
-class Tiger : public Animal{
-    private:
-        std::string name;
-    
-    protected:
-
-    public:
-        Tiger(const std::string& name){
-            this->name = name;
-            std::cout << "Tiger " << name << " created" << std::endl;
-        }
-
-        ~Tiger(){
-            std::cout << "Tiger " << name << " destroyed" << std::endl;
-        }
-
-        std::string getName() const {
-            return name;
-        }
-
-        void accept(AnimalVisitor& visitor) const override{
-            visitor.visit(*this);
-        }
-};
-
-// 具体访问者类
-class FeedingVisitor : public AnimalVisitor {
-public:
-    FeedingVisitor() {
-        std::cout << "FeedingVisitor created" << std::endl;
-    }
-
-    ~FeedingVisitor() {
-        std::cout << "FeedingVisitor destroyed" << std::endl;
-    }
-
-    void visit(const Lion& lion) override {
-        std::cout << "Feeding to Lion: " << lion.getName() << std::endl;
-    }
-
-    void visit(const Tiger& tiger) override {
-        std::cout << "Feeding to Tiger: " << tiger.getName() << std::endl;
-    }
-};
-
-// 对象结构类
-class Zoo {
-private:
-    std::vector<std::unique_ptr<Animal>> animals;
-
-public:
-    Zoo() {
-        std::cout << "Zoo created" << std::endl;
-    }
-
-    ~Zoo() {
-        std::cout << "Zoo destroyed" << std::endl;
-    }
-
-    void addAnimal(std::unique_ptr<Animal> animal) {
-        animals.push_back(std::move(animal));
-    }
-
-    void accept(AnimalVisitor& visitor) {
-        std::cout << "---START---" << std::endl;
-        for (const auto& animal : animals) {
-            animal->accept(visitor);
-        }
-        std::cout << "----END----" << std::endl;
-    }
-};
+#include <filesystem>
+#include "visitor.h"
 
 int main() {
-    // 使用智能指针管理内存
+    // 动物按类型连续存放，预留容量后不会发生移动
     Zoo zoo;
-    zoo.addAnimal(std::make_unique<Lion>("Simba"));
-    zoo.addAnimal(std::make_unique<Lion>("Mufasa"));
-    zoo.addAnimal(std::make_unique<Tiger>("Shere Khan"));
-    zoo.addAnimal(std::make_unique<Tiger>("Sher Khan"));
+    zoo.reserve(2, 2);
+    Lion& simba = zoo.emplaceAnimal<Lion>("Simba");
+    zoo.emplaceAnimal<Lion>("Mufasa");
+    zoo.emplaceAnimal<Tiger>("Shere Khan");
+    zoo.emplaceAnimal<Tiger>("Sher Khan");
     
     FeedingVisitor feedingVisitor;
     zoo.accept(feedingVisitor);
+
+    FoodQuotaVisitor foodQuotaVisitor;
+    zoo.accept(foodQuotaVisitor);
+    LOG_INFO("Food quota: ", foodQuotaVisitor.getLionCount(), " lions, ", foodQuotaVisitor.getTigerCount(), " tigers, ", foodQuotaVisitor.getMeat(), " kg meat");
+
+    FoodQuotaVisitor parallelQuotaVisitor;
+    zoo.parallelAccept(parallelQuotaVisitor);
+    LOG_INFO("Parallel food quota: ", parallelQuotaVisitor.getMeat(), " kg meat");
+
+    // 增量访问：第二次只访问改过名的动物
+    NameIndexVisitor nameIndexVisitor;
+    zoo.acceptIncremental(nameIndexVisitor);
+    simba.setName(zoo.names(), "Kiara");
+    zoo.markModified(simba);
+    zoo.acceptIncremental(nameIndexVisitor);
+    LOG_INFO("Name index: total length ", nameIndexVisitor.getTotal(), ", ", nameIndexVisitor.getVisits(), " visits");
+
+    // 其他种类的动物也可以直接构造在arena中；reset()一次性释放全部动物
+    Zoo arenaZoo;
+    arenaZoo.makeAnimal<Lion>("Nala");
+    arenaZoo.makeAnimal<Tiger>("Rajah");
+    arenaZoo.accept(feedingVisitor);
+    arenaZoo.reset();
+
+    // 写出二进制镜像，再通过内存映射直接遍历
+    std::string imagePath = (std::filesystem::temp_directory_path() / "zoo.img").string();
+    ZooImageWriter::write(zoo, imagePath);
+    {
+        MappedZoo mappedZoo(imagePath);
+        mappedZoo.accept(feedingVisitor);
+    }
+    std::filesystem::remove(imagePath);
     
     return 0;
-}
\ No newline at end of file
+}
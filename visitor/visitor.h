@@ -0,0 +1,877 @@
+#ifndef VISITOR_VISITOR_H
+#define VISITOR_VISITOR_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include "../common/log.h"
+#include "../common/mapped_file.h"
+#include "../common/thread_pool.h"
+
+// 名字驻留表：相同的名字只保存一份，动物只持有指向它的string_view
+// 每个Zoo一个，字符串直接分配在Zoo的单调arena中，随Zoo析构或reset()一起释放；不是线程安全的
+// 查找表是开放寻址的平坦数组，放在普通堆上：扩容时旧数组立即释放，不会像arena中的哈希桶那样留到reset()
+class NameTable {
+private:
+    std::pmr::memory_resource* resource;
+    std::vector<std::string_view> slots;// 容量为2的幂，data()为nullptr的是空槽；指向resource中的字符串
+    std::size_t count = 0;
+
+    // 线性探测：返回name所在的槽，或者应当放入name的空槽
+    std::size_t find(std::string_view name, std::size_t hash) const {
+        std::size_t mask = slots.size() - 1;
+        std::size_t index = hash & mask;
+        while (slots[index].data() != nullptr && slots[index] != name) {
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    // 装载因子保持在1/2以下，探测序列短
+    void rehash(std::size_t capacity) {
+        std::vector<std::string_view> old(capacity);
+        old.swap(slots);
+        for (std::string_view name : old) {
+            if (name.data() != nullptr) {
+                slots[find(name, std::hash<std::string_view>()(name))] = name;
+            }
+        }
+    }
+
+public:
+    explicit NameTable(std::pmr::memory_resource* resource) : resource(resource) {}
+    NameTable(const NameTable&) = delete;
+    NameTable& operator=(const NameTable&) = delete;
+
+    // 预留nameCount个不同名字的空间，之后加入这些名字时不再扩容
+    void reserve(std::size_t nameCount) {
+        std::size_t capacity = std::max<std::size_t>(slots.size(), 16);
+        while (capacity < nameCount * 2 + 1) {
+            capacity *= 2;
+        }
+        if (capacity != slots.size()) {
+            rehash(capacity);
+        }
+    }
+
+    // 返回驻留后的名字，内容相同的名字返回同一个view
+    std::string_view intern(std::string_view name) {
+        reserve(count + 1);
+        std::size_t hash = std::hash<std::string_view>()(name);
+        std::size_t index = find(name, hash);
+        if (slots[index].data() != nullptr) {
+            return slots[index];
+        }
+        char* data = static_cast<char*>(resource->allocate(std::max<std::size_t>(name.size(), 1), 1));
+        std::copy(name.begin(), name.end(), data);
+        slots[index] = std::string_view(data, name.size());
+        count++;
+        return slots[index];
+    }
+
+    // 不同名字的个数
+    std::size_t size() const {
+        return count;
+    }
+
+    // 丢弃全部名字（字符串的内存由resource的所有者回收），之前返回的view全部失效
+    void clear() {
+        std::vector<std::string_view>().swap(slots);
+        count = 0;
+    }
+};
+
+// 前向声明
+class Lion;
+class Tiger;
+// 抽象访问者基类
+class AnimalVisitor {
+public:
+    virtual ~AnimalVisitor() = default;
+    virtual void visit(const Lion& lion) = 0;
+    virtual void visit(const Tiger& tiger) = 0;
+
+    // 批量访问连续存放的同类动物，每批只有一次虚调用；默认逐个调用visit()，需要时重写为紧凑的循环
+    virtual void visitBatch(const Lion* lions, std::size_t count);
+    virtual void visitBatch(const Tiger* tigers, std::size_t count);
+};
+
+// 抽象元素基类
+class Animal {
+public:
+    virtual ~Animal() = default;
+    virtual void accept(AnimalVisitor& visitor) const = 0;
+};
+
+class MappedZoo;
+
+// 具体元素类
+class Lion : public Animal {
+private:
+    friend class MappedZoo;
+
+    // 只借用name，不驻留也不输出日志；供MappedZoo构造指向映射文件的视图对象
+    struct Borrowed {};
+
+    std::string_view name;// 指向NameTable中的驻留字符串
+
+    Lion(Borrowed, std::string_view name) : name(name) {}
+
+public:
+    // 名字驻留在names中，names必须比Lion活得长；通过Zoo构造时自动使用Zoo的names()
+    Lion(NameTable& names, std::string_view name) : name(names.intern(name)) {
+        LOG_DEBUG("Lion ", name, " created");
+    }
+
+    // 连续数组扩容时移动而不是拷贝；被移走的对象名字为空，析构时不再输出日志
+    Lion(const Lion&) = default;
+    Lion& operator=(const Lion&) = default;
+
+    Lion(Lion&& other) noexcept : name(std::exchange(other.name, std::string_view())) {}
+
+    Lion& operator=(Lion&& other) noexcept {
+        name = std::exchange(other.name, std::string_view());
+        return *this;
+    }
+
+    std::string_view getName() const {
+        return name;
+    }
+
+    // 修改后需要调用Zoo::markModified()，增量访问者才能看到变化
+    void setName(NameTable& names, std::string_view name) {
+        this->name = names.intern(name);
+    }
+
+    void accept(AnimalVisitor& visitor) const override {
+        visitor.visit(*this);
+    }
+
+    ~Lion() {
+        if (name.data() != nullptr) {
+            LOG_DEBUG("Lion ", name, " destroyed");
+        }
+    }
+};
+
+class Tiger : public Animal{
+    private:
+        friend class MappedZoo;
+
+        //只借用name，不驻留也不输出日志；供MappedZoo构造指向映射文件的视图对象
+        struct Borrowed {};
+
+        std::string_view name;//指向NameTable中的驻留字符串
+
+        Tiger(Borrowed, std::string_view name) : name(name){}
+    
+    protected:
+
+    public:
+        //名字驻留在names中，names必须比Tiger活得长；通过Zoo构造时自动使用Zoo的names()
+        Tiger(NameTable& names, std::string_view name) : name(names.intern(name)){
+            LOG_DEBUG("Tiger ", name, " created");
+        }
+
+        //连续数组扩容时移动而不是拷贝；被移走的对象名字为空，析构时不再输出日志
+        Tiger(const Tiger&) = default;
+        Tiger& operator=(const Tiger&) = default;
+
+        Tiger(Tiger&& other) noexcept : name(std::exchange(other.name, std::string_view())){}
+
+        Tiger& operator=(Tiger&& other) noexcept{
+            name = std::exchange(other.name, std::string_view());
+            return *this;
+        }
+
+        ~Tiger(){
+            if(name.data() != nullptr){
+                LOG_DEBUG("Tiger ", name, " destroyed");
+            }
+        }
+
+        std::string_view getName() const {
+            return name;
+        }
+
+        //修改后需要调用Zoo::markModified()，增量访问者才能看到变化
+        void setName(NameTable& names, std::string_view name){
+            this->name = names.intern(name);
+        }
+
+        void accept(AnimalVisitor& visitor) const override{
+            visitor.visit(*this);
+        }
+};
+
+inline void AnimalVisitor::visitBatch(const Lion* lions, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        visit(lions[i]);
+    }
+}
+
+inline void AnimalVisitor::visitBatch(const Tiger* tigers, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        visit(tigers[i]);
+    }
+}
+
+// 具体访问者类
+class FeedingVisitor : public AnimalVisitor {
+public:
+    FeedingVisitor() {
+        LOG_DEBUG("FeedingVisitor created");
+    }
+
+    ~FeedingVisitor() {
+        LOG_DEBUG("FeedingVisitor destroyed");
+    }
+
+    void visit(const Lion& lion) override {
+        LOG_DEBUG("Feeding to Lion: ", lion.getName());
+    }
+
+    void visit(const Tiger& tiger) override {
+        LOG_DEBUG("Feeding to Tiger: ", tiger.getName());
+    }
+};
+
+// 可以并行执行的访问者：每个工作线程使用fork()得到的独立副本累加，全部完成后依次merge()回原访问者
+// 适用于只读的汇总类访问（计数、求和、配额），访问者之间不共享可变状态，不需要加锁
+class ParallelAnimalVisitor : public AnimalVisitor {
+public:
+    // 返回一个处于初始状态的同类访问者
+    virtual std::unique_ptr<ParallelAnimalVisitor> fork() const = 0;
+    // 把fork()得到的副本的结果合并进来，other一定是fork()返回的对象
+    virtual void merge(const ParallelAnimalVisitor& other) = 0;
+};
+
+// 统计每天需要的肉量；批量接口按类型整批累加，不需要逐个访问
+class FoodQuotaVisitor : public ParallelAnimalVisitor {
+private:
+    static constexpr double LionMeat = 8.0;// 每只每天的肉量（千克）
+    static constexpr double TigerMeat = 6.0;
+
+    std::size_t lionCount = 0;
+    std::size_t tigerCount = 0;
+
+public:
+    void visit(const Lion&) override {
+        lionCount++;
+    }
+
+    void visit(const Tiger&) override {
+        tigerCount++;
+    }
+
+    void visitBatch(const Lion*, std::size_t count) override {
+        lionCount += count;
+    }
+
+    void visitBatch(const Tiger*, std::size_t count) override {
+        tigerCount += count;
+    }
+
+    std::unique_ptr<ParallelAnimalVisitor> fork() const override {
+        return std::make_unique<FoodQuotaVisitor>();
+    }
+
+    void merge(const ParallelAnimalVisitor& other) override {
+        const auto& partial = static_cast<const FoodQuotaVisitor&>(other);
+        lionCount += partial.lionCount;
+        tigerCount += partial.tigerCount;
+    }
+
+    std::size_t getLionCount() const {
+        return lionCount;
+    }
+
+    std::size_t getTigerCount() const {
+        return tigerCount;
+    }
+
+    double getMeat() const {
+        return lionCount * LionMeat + tigerCount * TigerMeat;
+    }
+};
+
+// 增量访问者：Zoo::acceptIncremental()只访问上一次运行之后新加入或被markModified()标记的动物
+// 访问者按动物地址缓存自己的结果，再次访问同一只动物时覆盖旧结果
+class IncrementalAnimalVisitor : public AnimalVisitor {
+private:
+    friend class Zoo;
+
+    // 上一次运行时的进度，由Zoo维护
+    std::uint64_t epoch = 0;// 0表示从未运行
+    std::size_t lionsSeen = 0;
+    std::size_t tigersSeen = 0;
+    std::size_t animalsSeen = 0;
+    std::size_t changesSeen = 0;
+
+public:
+    // 需要从头计算时调用（第一次运行、换了Zoo、Zoo被reset()、连续数组重新分配等），随后会访问全部动物
+    virtual void reset() = 0;
+};
+
+// 按动物缓存名字长度并维护总长度，动物改名后只需要重新访问它
+class NameIndexVisitor : public IncrementalAnimalVisitor {
+private:
+    std::unordered_map<const Animal*, std::size_t> lengths;
+    std::size_t total = 0;
+    std::size_t visits = 0;// 累计访问次数
+
+    void record(const Animal& animal, std::size_t length) {
+        std::size_t& cached = lengths[&animal];
+        total = total - cached + length;
+        cached = length;
+        visits++;
+    }
+
+public:
+    void visit(const Lion& lion) override {
+        record(lion, lion.getName().size());
+    }
+
+    void visit(const Tiger& tiger) override {
+        record(tiger, tiger.getName().size());
+    }
+
+    void reset() override {
+        lengths.clear();
+        total = 0;
+    }
+
+    std::size_t getTotal() const {
+        return total;
+    }
+
+    std::size_t getVisits() const {
+        return visits;
+    }
+};
+
+// 统计名字总长度，用于对比不同分派方式的开销；声明为final，静态分派时编译器可以内联visit()
+class NameLengthVisitor final : public ParallelAnimalVisitor {
+private:
+    std::size_t total = 0;
+
+public:
+    void visit(const Lion& lion) override {
+        total += lion.getName().size();
+    }
+
+    void visit(const Tiger& tiger) override {
+        total += tiger.getName().size();
+    }
+
+    std::unique_ptr<ParallelAnimalVisitor> fork() const override {
+        return std::make_unique<NameLengthVisitor>();
+    }
+
+    void merge(const ParallelAnimalVisitor& other) override {
+        total += static_cast<const NameLengthVisitor&>(other).total;
+    }
+
+    std::size_t getTotal() const {
+        return total;
+    }
+};
+
+// 把只提供visit(const Lion&)/visit(const Tiger&)的任意类型包装成AnimalVisitor，用于访问addAnimal()加入的动物
+template<typename Visitor>
+class AnimalVisitorAdapter : public AnimalVisitor {
+private:
+    Visitor& visitor;
+
+public:
+    explicit AnimalVisitorAdapter(Visitor& visitor) : visitor(visitor) {}
+
+    void visit(const Lion& lion) override {
+        visitor.visit(lion);
+    }
+
+    void visit(const Tiger& tiger) override {
+        visitor.visit(tiger);
+    }
+};
+
+// 对象结构类
+// Lion和Tiger按类型连续存放在各自的数组中，遍历是顺序扫描，不需要逐个分配、也不需要逐个解引用指针；
+// 其他Animal子类通过addAnimal()以unique_ptr加入，或者通过makeAnimal()直接构造在Zoo的arena中
+// 连续数组和makeAnimal()的对象都从单调arena（std::pmr::monotonic_buffer_resource）中顺序分配，
+// 析构或reset()时整块归还给上游分配器，不再逐个free
+class Zoo {
+private:
+    // addAnimal()的对象用delete释放，makeAnimal()的对象只调用析构函数，内存随arena一起归还
+    struct AnimalDeleter {
+        bool inArena;
+
+        void operator()(Animal* animal) const {
+            if (inArena) {
+                animal->~Animal();
+            } else {
+                delete animal;
+            }
+        }
+    };
+
+    using AnimalPtr = std::unique_ptr<Animal, AnimalDeleter>;
+
+    std::pmr::monotonic_buffer_resource arena;// 必须先于下面的容器构造、晚于它们析构
+    NameTable nameTable{&arena};// 晚于动物析构，析构日志中仍然可以读取名字
+    std::pmr::vector<Lion> lions{&arena};
+    std::pmr::vector<Tiger> tigers{&arena};
+    std::pmr::vector<AnimalPtr> animals{&arena};
+    // 增量访问：epoch变化说明之前缓存的地址全部失效；changes记录markModified()的动物，新加入的动物按数组下标识别
+    std::uint64_t epoch = nextEpoch();
+    std::vector<const Animal*> changes;
+
+    // 全局递增，不同Zoo的epoch也不会相同
+    static std::uint64_t nextEpoch() {
+        static std::atomic<std::uint64_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    void invalidate() {
+        epoch = nextEpoch();
+        changes.clear();
+    }
+
+    void visitAll(AnimalVisitor& visitor) {
+        if (!lions.empty()) {
+            visitor.visitBatch(lions.data(), lions.size());
+        }
+        if (!tigers.empty()) {
+            visitor.visitBatch(tigers.data(), tigers.size());
+        }
+        for (const auto& animal : animals) {
+            animal->accept(visitor);
+        }
+    }
+
+    // 可以用Zoo的名字表构造的类型（Lion、Tiger）自动传入nameTable
+    template<typename A, typename... Args>
+    A* construct(void* memory, Args&&... args) {
+        if constexpr (std::is_constructible_v<A, NameTable&, Args&&...>) {
+            return new (memory) A(nameTable, std::forward<Args>(args)...);
+        } else {
+            return new (memory) A(std::forward<Args>(args)...);
+        }
+    }
+
+    template<typename A>
+    std::pmr::vector<A>& storage() {
+        if constexpr (std::is_same_v<A, Lion>) {
+            return lions;
+        } else {
+            static_assert(std::is_same_v<A, Tiger>, "only Lion and Tiger have contiguous storage");
+            return tigers;
+        }
+    }
+
+public:
+    // upstream是arena向其申请大块内存的分配器
+    explicit Zoo(std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) : arena(upstream) {
+        LOG_DEBUG("Zoo created");
+    }
+
+    Zoo(const Zoo&) = delete;
+    Zoo& operator=(const Zoo&) = delete;
+
+    ~Zoo() {
+        LOG_DEBUG("Zoo destroyed");
+    }
+
+    // 在连续数组中就地构造；数组扩容时已有元素会被移动，返回的引用只在下一次emplaceAnimal()之前有效
+    // 扩容会改变已有元素的地址，增量访问者下一次需要从头计算
+    template<typename A, typename... Args>
+    A& emplaceAnimal(Args&&... args) {
+        auto& array = storage<A>();
+        if (array.size() == array.capacity()) {
+            invalidate();
+        }
+        return array.emplace_back(nameTable, std::forward<Args>(args)...);
+    }
+
+    // 预留容量，避免构造大量动物时反复扩容；arena中扩容前的旧缓冲区要到reset()或析构时才回收
+    // nameCount是预计的不同名字个数，名字表按它预先分配查找表
+    void reserve(std::size_t lionCount, std::size_t tigerCount, std::size_t nameCount = 0) {
+        if (lionCount > lions.capacity() || tigerCount > tigers.capacity()) {
+            invalidate();
+        }
+        lions.reserve(lionCount);
+        tigers.reserve(tigerCount);
+        nameTable.reserve(nameCount);
+    }
+
+    // Lion、Tiger的名字应当驻留在names()中，否则Zoo不能保证名字的生命周期
+    void addAnimal(std::unique_ptr<Animal> animal) {
+        animals.push_back(AnimalPtr(animal.release(), AnimalDeleter{false}));
+    }
+
+    // 兼容旧接口zoo.addAnimal(std::make_unique<Lion>(name))：Lion/Tiger不再有只接受名字的构造函数，
+    // 名字必须驻留在某个NameTable中；这两个函数使用本Zoo的名字表，动物放在连续数组中
+    Lion& addLion(std::string_view name) {
+        return emplaceAnimal<Lion>(name);
+    }
+
+    Tiger& addTiger(std::string_view name) {
+        return emplaceAnimal<Tiger>(name);
+    }
+
+    // 在arena中构造任意Animal子类，替代addAnimal(std::make_unique<A>(...))，没有单独的堆分配
+    template<typename A, typename... Args>
+    A& makeAnimal(Args&&... args) {
+        static_assert(std::is_base_of_v<Animal, A>, "A must derive from Animal");
+        void* memory = arena.allocate(sizeof(A), alignof(A));
+        A* animal = construct<A>(memory, std::forward<Args>(args)...);// 构造失败时内存留在arena中，reset()时回收
+        animals.push_back(AnimalPtr(animal, AnimalDeleter{true}));
+        return *animal;
+    }
+
+    // 销毁全部动物、丢弃名字表，并把arena占用的内存一次性归还给上游分配器，之后Zoo可以重新使用
+    void reset() {
+        animals.clear();
+        lions.clear();
+        tigers.clear();
+        // 容器的缓冲区也在arena中，换成空容器后才能释放arena
+        std::pmr::vector<AnimalPtr>(&arena).swap(animals);
+        std::pmr::vector<Lion>(&arena).swap(lions);
+        std::pmr::vector<Tiger>(&arena).swap(tigers);
+        nameTable.clear();
+        arena.release();
+        invalidate();
+    }
+
+    // 标记动物已被修改，下一次acceptIncremental()会重新访问它
+    // 修改记录比动物还多时直接丢弃，让增量访问者从头计算，记录的长度因此有上限
+    void markModified(const Animal& animal) {
+        if (changes.size() >= size()) {
+            invalidate();
+            return;
+        }
+        changes.push_back(&animal);
+    }
+
+    // 本Zoo的名字表：单独构造Lion/Tiger（例如addAnimal(std::make_unique<Lion>(zoo.names(), ...))）或改名时使用
+    NameTable& names() {
+        return nameTable;
+    }
+
+    const std::pmr::vector<Lion>& getLions() const {
+        return lions;
+    }
+
+    const std::pmr::vector<Tiger>& getTigers() const {
+        return tigers;
+    }
+
+    std::size_t size() const {
+        return lions.size() + tigers.size() + animals.size();
+    }
+
+    // 依次访问所有Lion、所有Tiger，再访问addAnimal()加入的其他动物
+    // 连续数组中的元素类型已知，整批交给visitBatch()，同一类型在一个循环里处理完，不再在两种visit()之间来回切换
+    void accept(AnimalVisitor& visitor) {
+        LOG_DEBUG("---START---");
+        visitAll(visitor);
+        LOG_DEBUG("----END----");
+    }
+
+    // 增量访问：第一次运行或缓存失效时调用visitor.reset()并访问全部动物；
+    // 否则只访问上一次运行之后新加入的动物和被markModified()标记的动物（同一只动物可能被访问多次）
+    void acceptIncremental(IncrementalAnimalVisitor& visitor) {
+        LOG_DEBUG("---START---");
+        if (visitor.epoch != epoch) {
+            visitor.reset();
+            visitAll(visitor);
+        } else {
+            if (visitor.lionsSeen < lions.size()) {
+                visitor.visitBatch(lions.data() + visitor.lionsSeen, lions.size() - visitor.lionsSeen);
+            }
+            if (visitor.tigersSeen < tigers.size()) {
+                visitor.visitBatch(tigers.data() + visitor.tigersSeen, tigers.size() - visitor.tigersSeen);
+            }
+            for (std::size_t i = visitor.animalsSeen; i < animals.size(); i++) {
+                animals[i]->accept(visitor);
+            }
+            for (std::size_t i = visitor.changesSeen; i < changes.size(); i++) {
+                changes[i]->accept(visitor);
+            }
+        }
+        visitor.epoch = epoch;
+        visitor.lionsSeen = lions.size();
+        visitor.tigersSeen = tigers.size();
+        visitor.animalsSeen = animals.size();
+        visitor.changesSeen = changes.size();
+        LOG_DEBUG("----END----");
+    }
+
+    // 并行访问：把lions、tigers和其他动物切成至少minChunk个元素的块，线程池中的线程和调用方线程循环领取，
+    // 每个线程在第一次领到块时fork()一个副本，全部完成后按线程顺序merge()进visitor
+    // 访问期间不能修改Zoo；visit()抛出的第一个异常会在合并前重新抛出，此时visitor保持不变
+    void parallelAccept(ParallelAnimalVisitor& visitor, ThreadPool& pool = ThreadPool::shared(), std::size_t minChunk = 4096) {
+        struct Chunk {
+            int kind;// 0: lions，1: tigers，2: animals
+            std::size_t begin;
+            std::size_t end;
+        };
+        std::vector<Chunk> chunks;
+
+        // 每个线程约4块，先做完的线程继续领取，平衡负载
+        minChunk = std::max<std::size_t>(minChunk, 1);
+        std::size_t chunkSize = std::max(minChunk, size() / (pool.size() * 4) + 1);
+        auto split = [&chunks, chunkSize](int kind, std::size_t count) {
+            for (std::size_t begin = 0; begin < count; begin += chunkSize) {
+                chunks.push_back(Chunk{kind, begin, std::min(count, begin + chunkSize)});
+            }
+        };
+        split(0, lions.size());
+        split(1, tigers.size());
+        split(2, animals.size());
+
+        LOG_DEBUG("---START---");
+        // 每个slot（领取线程）一个副本，第一次领到块时才fork()
+        std::vector<std::unique_ptr<ParallelAnimalVisitor>> partials(pool.size() + 1);
+        pool.forEachChunk(chunks.size(), [this, &chunks, &partials, &visitor](std::size_t index, std::size_t slot) {
+            const Chunk& chunk = chunks[index];
+            auto& partial = partials[slot];
+            if (!partial) {
+                partial = visitor.fork();
+            }
+            if (chunk.kind == 0) {
+                partial->visitBatch(lions.data() + chunk.begin, chunk.end - chunk.begin);
+            } else if (chunk.kind == 1) {
+                partial->visitBatch(tigers.data() + chunk.begin, chunk.end - chunk.begin);
+            } else {
+                for (std::size_t i = chunk.begin; i < chunk.end; i++) {
+                    animals[i]->accept(*partial);
+                }
+            }
+        });
+        for (const auto& partial : partials) {
+            if (partial) {
+                visitor.merge(*partial);
+            }
+        }
+        LOG_DEBUG("----END----");
+    }
+
+    // 编译期分派：Visitor可以是任何提供visit(const Lion&)/visit(const Tiger&)的类型，不必继承AnimalVisitor
+    // 连续数组部分由编译器直接绑定到Visitor::visit()并内联，没有虚调用；addAnimal()加入的动物仍然走双重分派
+    template<typename Visitor>
+    void acceptStatic(Visitor& visitor) {
+        for (const Lion& lion : lions) {
+            visitor.visit(lion);
+        }
+        for (const Tiger& tiger : tigers) {
+            visitor.visit(tiger);
+        }
+        if (animals.empty()) {
+            return;
+        }
+        if constexpr (std::is_base_of_v<AnimalVisitor, Visitor>) {
+            for (const auto& animal : animals) {
+                animal->accept(visitor);
+            }
+        } else {
+            AnimalVisitorAdapter<Visitor> adapter(visitor);
+            for (const auto& animal : animals) {
+                animal->accept(adapter);
+            }
+        }
+    }
+};
+
+// Zoo的二进制镜像格式，所有整数为本机字节序（byteOrder用于识别字节序不同的文件）：
+// [ZooImageHeader][AnimalRecord × recordCount][名字表]
+// 记录定长、紧跟在文件头之后，名字表中每个不同的名字只保存一次，记录通过偏移量引用
+struct ZooImageHeader {
+    char magic[8];// "ZOOIMG\0\0"
+    std::uint32_t version;
+    std::uint32_t byteOrder;// 0x01020304
+    std::uint64_t recordCount;
+    std::uint64_t namesOffset;// 名字表在文件中的偏移
+    std::uint64_t namesSize;
+};
+
+struct AnimalRecord {
+    std::uint32_t type;// AnimalType
+    std::uint32_t nameLength;
+    std::uint64_t nameOffset;// 在名字表中的偏移
+};
+
+enum class AnimalType : std::uint32_t {
+    Lion = 1,
+    Tiger = 2
+};
+
+// 直接访问MappedZoo映射中的记录，不构造任何动物对象
+// record的地址在MappedZoo的生命周期内保持不变，可以作为动物的标识；name指向映射中的名字表
+class MappedAnimalVisitor {
+public:
+    virtual ~MappedAnimalVisitor() = default;
+    virtual void visit(const AnimalRecord& record, std::string_view name) = 0;
+};
+
+inline constexpr char ZooImageMagic[8] = {'Z', 'O', 'O', 'I', 'M', 'G', 0, 0};
+inline constexpr std::uint32_t ZooImageVersion = 1;
+inline constexpr std::uint32_t ZooImageByteOrder = 0x01020304;
+
+// 把Zoo写成二进制镜像：按accept()的顺序为每只动物生成一条记录，名字去重后放进名字表
+class ZooImageWriter final : public AnimalVisitor {
+private:
+    std::vector<AnimalRecord> records;
+    std::string names;
+    std::unordered_map<std::string_view, std::uint64_t> nameOffsets;// 指向Zoo中驻留的名字
+
+    void add(AnimalType type, std::string_view name) {
+        auto it = nameOffsets.find(name);
+        if (it == nameOffsets.end()) {
+            it = nameOffsets.emplace(name, names.size()).first;
+            names.append(name.data(), name.size());
+        }
+        records.push_back(AnimalRecord{static_cast<std::uint32_t>(type), static_cast<std::uint32_t>(name.size()), it->second});
+    }
+
+public:
+    void visit(const Lion& lion) override {
+        add(AnimalType::Lion, lion.getName());
+    }
+
+    void visit(const Tiger& tiger) override {
+        add(AnimalType::Tiger, tiger.getName());
+    }
+
+    // 写入失败时抛出std::runtime_error
+    void writeTo(const std::string& path) const {
+        ZooImageHeader header{};
+        std::memcpy(header.magic, ZooImageMagic, sizeof(header.magic));
+        header.version = ZooImageVersion;
+        header.byteOrder = ZooImageByteOrder;
+        header.recordCount = records.size();
+        header.namesOffset = sizeof(ZooImageHeader) + records.size() * sizeof(AnimalRecord);
+        header.namesSize = names.size();
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(AnimalRecord));
+        out.write(names.data(), names.size());
+        out.close();
+        if (!out) {
+            throw std::runtime_error("cannot write zoo image " + path);
+        }
+    }
+
+    static void write(Zoo& zoo, const std::string& path) {
+        ZooImageWriter writer;
+        zoo.acceptStatic(writer);
+        writer.writeTo(path);
+    }
+};
+
+// 内存映射的Zoo镜像：打开时只检查文件头，accept()直接遍历映射中的定长记录，不构造Zoo、不复制名字、也不驻留名字
+// accept(MappedAnimalVisitor&)把记录本身交给访问者；accept(AnimalVisitor&)为每条记录构造一个临时的Lion/Tiger视图，
+// 名字指向映射中的名字表，visit()返回后视图即被销毁，访问者不能保存它的地址
+class MappedZoo {
+private:
+    MappedFile file;
+    const ZooImageHeader* header = nullptr;
+    const AnimalRecord* records = nullptr;
+    const char* names = nullptr;
+
+    [[noreturn]] static void corrupt(const char* what) {
+        throw std::runtime_error(std::string("corrupt zoo image: ") + what);
+    }
+
+    // 依次检查每条记录并调用func(record, name)
+    template<typename Func>
+    void forEachRecord(Func&& func) const {
+        for (std::size_t i = 0; i < size(); i++) {
+            const AnimalRecord& record = records[i];
+            if (record.nameOffset > header->namesSize || record.nameLength > header->namesSize - record.nameOffset) {
+                corrupt("name out of range");
+            }
+            if (record.type != static_cast<std::uint32_t>(AnimalType::Lion) && record.type != static_cast<std::uint32_t>(AnimalType::Tiger)) {
+                corrupt("unknown animal type");
+            }
+            func(record, std::string_view(names + record.nameOffset, record.nameLength));
+        }
+    }
+
+    template<typename A>
+    static void visitView(AnimalVisitor& visitor, std::string_view name) {
+        A view(typename A::Borrowed{}, name);
+        visitor.visit(view);
+        view.name = std::string_view();// 名字是借用的，析构时不输出日志
+    }
+
+public:
+    // 文件不存在、格式或版本不符时抛出std::runtime_error
+    explicit MappedZoo(const std::string& path) : file(path) {
+        if (file.size() < sizeof(ZooImageHeader)) {
+            corrupt("truncated header");
+        }
+        header = reinterpret_cast<const ZooImageHeader*>(file.data());// 映射按页对齐
+        if (std::memcmp(header->magic, ZooImageMagic, sizeof(ZooImageMagic)) != 0) {
+            corrupt("bad magic");
+        }
+        if (header->byteOrder != ZooImageByteOrder) {
+            corrupt("byte order mismatch");
+        }
+        if (header->version != ZooImageVersion) {
+            corrupt("unsupported version");
+        }
+        std::uint64_t recordBytes = header->recordCount * sizeof(AnimalRecord);
+        if (header->recordCount > (file.size() - sizeof(ZooImageHeader)) / sizeof(AnimalRecord)
+            || header->namesOffset != sizeof(ZooImageHeader) + recordBytes
+            || header->namesSize > file.size() - header->namesOffset) {
+            corrupt("sections out of range");
+        }
+        records = reinterpret_cast<const AnimalRecord*>(file.data() + sizeof(ZooImageHeader));
+        names = file.data() + header->namesOffset;
+    }
+
+    std::size_t size() const {
+        return static_cast<std::size_t>(header->recordCount);
+    }
+
+    // 记录的类型未知或名字越界时抛出std::runtime_error
+    void accept(MappedAnimalVisitor& visitor) const {
+        LOG_DEBUG("---START---");
+        forEachRecord([&visitor](const AnimalRecord& record, std::string_view name) {
+            visitor.visit(record, name);
+        });
+        LOG_DEBUG("----END----");
+    }
+
+    // 每条记录一个视图对象，连续的视图可能位于同一个地址，不能按地址区分动物
+    void accept(AnimalVisitor& visitor) const {
+        LOG_DEBUG("---START---");
+        forEachRecord([&visitor](const AnimalRecord& record, std::string_view name) {
+            if (static_cast<AnimalType>(record.type) == AnimalType::Lion) {
+                visitView<Lion>(visitor, name);
+            } else {
+                visitView<Tiger>(visitor, name);
+            }
+        });
+        LOG_DEBUG("----END----");
+    }
+
+    // 增量访问者按动物地址缓存结果，视图对象的地址会被复用，所有动物会被当成同一只；需要标识时使用MappedAnimalVisitor
+    void accept(IncrementalAnimalVisitor& visitor) const = delete;
+};
+
+#endif